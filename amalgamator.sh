@@ -37,6 +37,7 @@ cat <<'EOF' >> ${F}
 #include <libgen.h>
 #include <limits.h>
 #include <poll.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -44,11 +45,20 @@ cat <<'EOF' >> ${F}
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <time.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 EOF
 
 cat ./basedefs.h >> ${F}
@@ -59,14 +69,18 @@ cat ./xstr.h >> ${F}
 cat ./ulist.h >> ${F}
 cat ./map.h >> ${F}
 cat ./utils.h >> ${F}
+cat ./vlist.h >> ${F}
 cat ./spawn.h >> ${F}
 cat ./paths.h >> ${F}
+cat ./pathid.h >> ${F}
 cat ./env.h >> ${F}
 cat ./deps.h >> ${F}
 cat ./fetchreg.h >> ${F}
 cat ./nodes.h >> ${F}
 cat ./autark.h >> ${F}
 cat ./script.h >> ${F}
+cat ./watch.h >> ${F}
+cat ./manifest.h >> ${F}
 
 cat ./xstr.c >> ${F}
 cat ./ulist.c >> ${F}
@@ -74,7 +88,9 @@ cat ./pool.c >> ${F}
 cat ./log.c >> ${F}
 cat ./map.c >> ${F}
 cat ./utils.c >> ${F}
+cat ./vlist.c >> ${F}
 cat ./paths.c >> ${F}
+cat ./pathid.c >> ${F}
 cat ./spawn.c >> ${F}
 cat ./deps.c >> ${F}
 cat ./fetchreg.c >> ${F}
@@ -101,6 +117,10 @@ cat ./node_find.c >> ${F}
 cat ./node_macro.c >> ${F}
 cat ./node_call.c >> ${F}
 cat ./node_fetch_url.c >> ${F}
+cat ./node_alias.c >> ${F}
+cat ./node_archive.c >> ${F}
+cat ./manifest.c >> ${F}
+cat ./watch.c >> ${F}
 cat ./autark_core.c >> ${F}
 cat ./main.c >> ${F}
 
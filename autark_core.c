@@ -12,12 +12,17 @@
 #include "utils.h"
 #include "log.h"
 #include "paths.h"
+#include "pathid.h"
 #include "script.h"
+#include "nodes.h"
 #include "autark.h"
 #include "map.h"
 #include "alloc.h"
 #include "deps.h"
 #include "fetchreg.h"
+#include "watch.h"
+#include "manifest.h"
+#include "spawn.h"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -37,6 +42,7 @@ static void _unit_destroy(struct unit *unit) {
 }
 
 void unit_env_set_val(struct unit *u, const char *key, const char *val) {
+  ++g_env.env_gen;
   size_t len = sizeof(struct unit_env_item);
   if (val) {
     len += strlen(val) + 1;
@@ -54,6 +60,7 @@ void unit_env_set_val(struct unit *u, const char *key, const char *val) {
 }
 
 void unit_env_set_node(struct unit *u, const char *key, struct node *n, unsigned tag) {
+  ++g_env.env_gen;
   struct unit_env_item *item = xmalloc(sizeof(*item));
   item->val = 0;
   item->n = n;
@@ -61,8 +68,20 @@ void unit_env_set_node(struct unit *u, const char *key, struct node *n, unsigned
   map_put_str(u->env, key, item);
 }
 
-struct node* unit_env_get_node(struct unit *u, const char *key, unsigned *out_tag) {
+struct unit_env_item* unit_env_item(struct unit *u, const char *key) {
   struct unit_env_item *item = map_get(u->env, key);
+  if (item && item->tag == TAG_CHECK) {
+    node_check_provide(item->n);
+    item = map_get(u->env, key);
+    if (item && item->tag == TAG_CHECK) {
+      return 0;
+    }
+  }
+  return item;
+}
+
+struct node* unit_env_get_node(struct unit *u, const char *key, unsigned *out_tag) {
+  struct unit_env_item *item = unit_env_item(u, key);
   if (item) {
     if (out_tag) {
       *out_tag = item->tag;
@@ -75,7 +94,7 @@ struct node* unit_env_get_node(struct unit *u, const char *key, unsigned *out_ta
 }
 
 const char* unit_env_get_raw(struct unit *u, const char *key) {
-  struct unit_env_item *item = map_get(u->env, key);
+  struct unit_env_item *item = unit_env_item(u, key);
   if (item) {
     if (item->val) {
       return item->val;
@@ -87,20 +106,11 @@ const char* unit_env_get_raw(struct unit *u, const char *key) {
 }
 
 const char* unit_env_get(struct node *n, const char *key) {
-  struct unit *prev = 0;
-  for (struct node *nn = n; nn; nn = nn->parent) {
-    if (nn->unit && nn->unit != prev) {
-      prev = nn->unit;
-      const char *ret = unit_env_get_raw(nn->unit, key);
-      if (ret) {
-        return ret;
-      }
-    }
-  }
-  return getenv(key);
+  return node_env_get(n, key);
 }
 
 void unit_env_remove(struct unit *u, const char *key) {
+  ++g_env.env_gen;
   map_remove(u->env, key);
 }
 
@@ -108,8 +118,8 @@ void on_unit_pool_destroy(struct pool *pool) {
   for (int i = 0; i < g_env.units.num; ++i) {
     struct unit *unit = *(struct unit**) ulist_get(&g_env.units, i);
     if (unit->pool == pool) {
-      map_remove(g_env.map_path_to_unit, unit->source_path);
-      map_remove(g_env.map_path_to_unit, unit->cache_path);
+      map_remove_u32(g_env.map_path_to_unit, pathid_find(unit->source_path));
+      map_remove_u32(g_env.map_path_to_unit, pathid_find(unit->cache_path));
       _unit_destroy(unit);
       ulist_remove(&g_env.units, i);
       --i;
@@ -118,8 +128,8 @@ void on_unit_pool_destroy(struct pool *pool) {
 }
 
 struct unit* unit_for_path(const char *path) {
-  struct unit *unit = map_get(g_env.map_path_to_unit, path);
-  return unit;
+  uint32_t id = pathid_find(path);
+  return id ? map_get_u32(g_env.map_path_to_unit, id) : 0;
 }
 
 struct unit* unit_create(const char *unit_path_, unsigned flags, struct pool *pool) {
@@ -160,8 +170,8 @@ struct unit* unit_create(const char *unit_path_, unsigned flags, struct pool *po
     akfatal(rc, "Failed to create directory: %s", path);
   }
 
-  map_put_str_no_copy(g_env.map_path_to_unit, unit->source_path, unit);
-  map_put_str_no_copy(g_env.map_path_to_unit, unit->cache_path, unit);
+  map_put_u32(g_env.map_path_to_unit, pathid_intern(unit->source_path), unit);
+  map_put_u32(g_env.map_path_to_unit, pathid_intern(unit->cache_path), unit);
   ulist_push(&g_env.units, &unit);
 
   if (g_env.verbose) {
@@ -295,6 +305,16 @@ static int _usage_va(
           "    -J  --jobs=<>               Number of jobs used in c/cxx compilation tasks. Default: 4\n");
   fprintf(stderr,
           "    -D<option>[=<val>]          Set project build option.\n");
+  fprintf(stderr,
+          "    -w, --watch                 Watch project sources and rebuild on changes (Linux only).\n");
+  fprintf(stderr,
+          "        --executor=<>           Command compiling preprocessed sources, eg: on remote build machines.\n"
+          "                                Default: $" AUTARK_EXECUTOR_ENV "\n");
+  fprintf(stderr,
+          "        --executor-jobs=<>      Number of compilation jobs passed to executor. Default: 4 x jobs\n");
+  fprintf(stderr,
+          "    -T, --target=<>             Build only the given alias or product (path or unique path suffix).\n"
+          "                                May be specified multiple times.\n");
   fprintf(stderr,
           "    -k, --compile-commands      Generates compile_commands.json database. Sets -c option implicitly.\n");
   fprintf(stderr,
@@ -341,6 +361,10 @@ static int _usage_va(
           "\nautark fetched <url> <target_dir>\n"
           "  Registers external resource located at <url> is downloaded to <target_dir>.\n"
           "  See .autark/fetch_resource.sh script.\n");
+  fprintf(stderr,
+          "\nautark worker <compiler> [flags]\n"
+          "  Local executor of compilation jobs. Compiles preprocessed source read from stdin,\n"
+          "  writes object file to stdout.\n");
 
   fprintf(stderr, "\n");
   return AK_ERROR_INVALID_ARGS;
@@ -614,6 +638,84 @@ static void _on_command_dep_env(int argc, const char **argv) {
   deps_close(&deps);
 }
 
+static void _worker_stdout_handler(char *buf, size_t buflen, struct spawn *s) {
+  // Stdout of worker is the object stream
+  fwrite(buf, 1, buflen, stderr);
+}
+
+static void _worker_stderr_handler(char *buf, size_t buflen, struct spawn *s) {
+  fwrite(buf, 1, buflen, stderr);
+}
+
+static void _worker_cmd_arg_print(int num, const char *arg, void *d) {
+  fprintf(stderr, num ? " %s" : "%s", arg);
+}
+
+// Local executor of compile jobs: compiles preprocessed source read from stdin
+// and writes the object file to stdout.
+static void _on_command_worker(int argc, const char **argv) {
+  if (optind >= argc) {
+    _usage("Missing required command arg: autark worker <compiler> [flags]");
+  }
+  char in[PATH_MAX], out[PATH_MAX];
+  const char *tmpdir = getenv("TMPDIR");
+  snprintf(in, sizeof(in), "%s/autark-worker-XXXXXX", tmpdir ? tmpdir : "/tmp");
+  int fd = mkstemp(in);
+  if (fd == -1) {
+    akfatal(errno, "Failed to create temp file: %s", in);
+  }
+  snprintf(out, sizeof(out), "%s.o", in);
+
+  FILE *f = fdopen(fd, "w");
+  if (!f) {
+    akfatal(errno, 0, 0);
+  }
+  int rc = utils_copy_file_streams(stdin, f);
+  fclose(f);
+  if (rc) {
+    unlink(in);
+    akfatal(rc, "Failed to read preprocessed source", 0);
+  }
+
+  struct spawn *s = spawn_create(argv[optind++], 0);
+  for ( ; optind < argc; ++optind) {
+    spawn_arg_add(s, argv[optind]);
+  }
+  spawn_arg_add(s, in);
+  spawn_arg_add(s, "-o");
+  spawn_arg_add(s, out);
+  spawn_set_stdout_handler(s, _worker_stdout_handler);
+  spawn_set_stderr_handler(s, _worker_stderr_handler);
+  // Stdout of worker is the object stream, so command line is printed to stderr
+  spawn_set_silent(s, true);
+  if (g_env.verbose) {
+    spawn_visit_cmd(s, 0, _worker_cmd_arg_print);
+    fputc('\n', stderr);
+  }
+
+  int code = 1;
+  rc = spawn_do(s);
+  if (!rc) {
+    code = spawn_exit_code(s);
+  }
+  spawn_destroy(s);
+  unlink(in);
+
+  if (code == 0) {
+    f = fopen(out, "r");
+    if (!f || utils_copy_file_streams(f, stdout)) {
+      akerror(errno, "Failed to read object file: %s", out);
+      code = 1;
+    }
+    if (f) {
+      fclose(f);
+    }
+    fflush(stdout);
+  }
+  unlink(out);
+  exit(code);
+}
+
 static void _on_command_glob(int argc, const char **argv, const char *cdir) {
   if (cdir) {
     akcheck(chdir(cdir));
@@ -658,7 +760,20 @@ void on_command_fetched(int argc, const char **argv) {
 
 #endif
 
-static void _build(struct ulist *options) {
+static void _build(struct ulist *options, struct ulist *targets, const char *cwd, const char **argv, const char *args) {
+  // Whole build manifest is not applicable to builds with side effects or interactive modes
+  bool manifest = !g_env.project.cleanup
+                  && !g_env.project.watch
+                  && !g_env.project.compile_commands
+                  && !g_env.install.enabled;
+  if (manifest) {
+    if (manifest_check(args)) {
+      akinfo("[%s] Build is up to date", g_env.project.root_dir);
+      return;
+    }
+    manifest_init();
+  }
+
   struct sctx *x;
   int rc = script_open(AUTARK_SCRIPT, &x);
   if (rc) {
@@ -679,7 +794,19 @@ static void _build(struct ulist *options) {
       unit_env_set_val(root, opt, "");
     }
   }
-  script_build(x);
+  if (g_env.project.watch) {
+    node_init(x->root);
+    node_setup(x->root);
+    watch_run(x, targets, cwd, (void*) argv);
+  }
+  if (targets->num) {
+    script_build_targets(x, targets);
+  } else {
+    script_build(x);
+  }
+  if (manifest) {
+    manifest_save(x, args);
+  }
   script_close(&x);
   akinfo("[%s] Build successful", g_env.project.root_dir);
 }
@@ -706,7 +833,8 @@ void autark_init(void) {
       akfatal(errno, 0, 0);
     }
     g_env.cwd = pool_strdup(g_env.pool, buf);
-    g_env.map_path_to_unit = map_create_str(0);
+    g_env.map_path_to_unit = map_create_u32(0);
+    pathid_init();
   }
 }
 
@@ -721,6 +849,9 @@ AK_DESTRUCTOR void autark_dispose(void) {
     ulist_destroy_keep(&g_env.units);
     ulist_destroy_keep(&g_env.stack_units);
     map_destroy(g_env.map_path_to_unit);
+    manifest_dispose();
+    pathid_dispose();
+    spawn_dispose();
     pool_destroy(pool);
     memset(&g_env, 0, sizeof(g_env));
   }
@@ -782,14 +913,19 @@ void autark_run(int argc, const char **argv) {
     { "pkgconfdir", 1, 0, -4 },
     { "mandir", 1, 0, -5 },
     { "datadir", 1, 0, -6 },
+    { "target", 1, 0, 'T' },
+    { "watch", 0, 0, 'w' },
+    { "executor", 1, 0, -7 },
+    { "executor-jobs", 1, 0, -8 },
     { 0 }
   };
 
   bool version = false;
   const char *cdir = 0;
   struct ulist options = { .usize = sizeof(char*) };
+  struct ulist targets = { .usize = sizeof(char*) };
 
-  for (int ch; (ch = getopt_long(argc, (void*) argv, "+H:ckhVvlR:C:D:J:IS", long_options, 0)) != -1; ) {
+  for (int ch; (ch = getopt_long(argc, (void*) argv, "+H:ckhVvlwR:C:D:J:T:IS", long_options, 0)) != -1; ) {
     switch (ch) {
       case 'H':
         g_env.project.cache_dir = pool_strdup(g_env.pool, optarg);
@@ -817,6 +953,14 @@ void autark_run(int argc, const char **argv) {
         ulist_push(&options, &p);
         break;
       }
+      case 'w':
+        g_env.project.watch = true;
+        break;
+      case 'T': {
+        char *p = pool_strdup(g_env.pool, optarg);
+        ulist_push(&targets, &p);
+        break;
+      }
       case 'R':
         g_env.install.enabled = true;
         g_env.install.prefix_dir = path_normalize_cwd_pool(optarg, g_env.cwd, g_env.pool);
@@ -849,6 +993,17 @@ void autark_run(int argc, const char **argv) {
       case -6:
         g_env.install.data_dir = pool_strdup(g_env.pool, optarg);
         break;
+      case -7:
+        g_env.executor.cmd = pool_strdup(g_env.pool, optarg);
+        break;
+      case -8: {
+        int rc = 0;
+        g_env.executor.jobs = utils_strtol(optarg, 10, &rc);
+        if (rc) {
+          akfatal(AK_ERROR_FAIL, "Command line option --executor-jobs value: %s should be non negative number", optarg);
+        }
+        break;
+      }
       case 'J': {
         int rc = 0;
         g_env.max_parallel_jobs = utils_strtol(optarg, 10, &rc);
@@ -883,6 +1038,12 @@ void autark_run(int argc, const char **argv) {
     g_env.project.cleanup = true;
   }
 
+  if (getenv(AUTARK_WATCH_ENV)) {
+    // Restarted by watch mode, build cache is kept
+    unsetenv(AUTARK_WATCH_ENV);
+    g_env.project.cleanup = false;
+  }
+
   char buf[PATH_MAX];
   const char *autark_home = getenv("AUTARK_HOME");
   if (!autark_home) {
@@ -931,6 +1092,21 @@ void autark_run(int argc, const char **argv) {
   if (g_env.max_parallel_jobs > 16) {
     g_env.max_parallel_jobs = 16;
   }
+  if (g_env.executor.cmd) {
+    // Inherited by autark processes of sub-projects
+    setenv(AUTARK_EXECUTOR_ENV, g_env.executor.cmd, 1);
+  } else {
+    const char *v = getenv(AUTARK_EXECUTOR_ENV);
+    if (v && *v != '\0') {
+      g_env.executor.cmd = pool_strdup(g_env.pool, v);
+    }
+  }
+  if (g_env.executor.jobs <= 0) {
+    g_env.executor.jobs = 4 * g_env.max_parallel_jobs;
+  }
+  if (g_env.executor.jobs > 256) {
+    g_env.executor.jobs = 256;
+  }
 
   if (optind < argc) {
     const char *arg = argv[optind];
@@ -950,18 +1126,28 @@ void autark_run(int argc, const char **argv) {
     } else if (strcmp(arg, "fetched") == 0) {
       _on_command_fetched(argc, argv);
       return;
+    } else if (strcmp(arg, "worker") == 0) {
+      _on_command_worker(argc, argv);
+      return;
     } else { // Root dir expected
       g_env.project.root_dir = pool_strdup(g_env.pool, arg);
     }
   }
 
+  const char *cwd = g_env.cwd;
   autark_build_prepare(AUTARK_SCRIPT);
 
   if (g_env.project.options) {
     _options();
   } else {
-    _build(&options);
+    struct xstr *args = xstr_create_empty();
+    for (int i = 1; i < argc; ++i) {
+      xstr_printf(args, "%s%s", i > 1 ? "\1" : "", argv[i]);
+    }
+    _build(&options, &targets, cwd, argv, xstr_ptr(args));
+    xstr_destroy(args);
   }
 
   ulist_destroy_keep(&options);
+  ulist_destroy_keep(&targets);
 }
@@ -3,7 +3,9 @@
 #include "log.h"
 #include "utils.h"
 #include "paths.h"
+#include "pathid.h"
 #include "env.h"
+#include "manifest.h"
 
 #include <errno.h>
 #include <assert.h>
@@ -85,14 +87,14 @@ bool deps_cur_is_outdated(struct node *n, struct deps *d) {
     switch (d->type) {
       case DEPS_TYPE_FILE: {
         struct akpath_stat st;
-        if (path_stat(d->resource, &st) || st.ftype == AKPATH_NOT_EXISTS || st.mtime > d->serial) {
+        if (pathid_stat(pathid_intern_normalized(d->resource), &st) || st.ftype == AKPATH_NOT_EXISTS || st.mtime > d->serial) {
           return true;
         }
         break;
       }
       case DEPS_TYPE_ALIAS: {
         struct akpath_stat st;
-        if (path_stat(d->alias, &st) || st.ftype == AKPATH_NOT_EXISTS || st.mtime > d->serial) {
+        if (pathid_stat(pathid_intern_normalized(d->alias), &st) || st.ftype == AKPATH_NOT_EXISTS || st.mtime > d->serial) {
           return true;
         }
         break;
@@ -105,7 +107,7 @@ bool deps_cur_is_outdated(struct node *n, struct deps *d) {
         return strcmp(val, d->resource) != 0;
       }
       case DEPS_TYPE_SYS_ENV: {
-        const char *val = getenv(d->alias);
+        const char *val = manifest_getenv(d->alias);
         if (!val) {
           val = "";
         }
@@ -113,7 +115,7 @@ bool deps_cur_is_outdated(struct node *n, struct deps *d) {
       }
       case DEPS_TYPE_FILE_NOT_EXISTS: {
         struct akpath_stat st;
-        if (path_stat(d->resource, &st) || st.ftype == AKPATH_NOT_EXISTS) {
+        if (pathid_stat(pathid_intern_normalized(d->resource), &st) || st.ftype == AKPATH_NOT_EXISTS) {
           return true;
         }
         break;
@@ -136,8 +138,9 @@ static int _deps_add(struct deps *d, char type, char flags, const char *resource
   if (type == DEPS_TYPE_FILE) {
     path_normalize(resource, buf[0]);
     resource = buf[0];
+    // Recorded files are known to the watch mode and the build manifest
     struct akpath_stat st;
-    if (!path_stat(resource, &st) && st.ftype != AKPATH_NOT_EXISTS) {
+    if (!pathid_stat_fresh(pathid_intern_normalized(resource), &st) && st.ftype != AKPATH_NOT_EXISTS) {
       serial = st.mtime;
     }
   } else if (type == DEPS_TYPE_ALIAS) {
@@ -146,7 +149,7 @@ static int _deps_add(struct deps *d, char type, char flags, const char *resource
     resource = buf[0];
     alias = buf[1];
     struct akpath_stat st;
-    if (!path_stat(alias, &st) && st.ftype != AKPATH_NOT_EXISTS) {
+    if (!pathid_stat_fresh(pathid_intern_normalized(alias), &st) && st.ftype != AKPATH_NOT_EXISTS) {
       serial = st.mtime;
     }
   } else if (type == DEPS_TYPE_ENV || type == DEPS_TYPE_NODE_VALUE || type == DEPS_TYPE_SYS_ENV) {
@@ -13,6 +13,7 @@
 #define TAG_INIT  1
 #define TAG_SETUP 2
 #define TAG_BUILD 3
+#define TAG_CHECK 4 // Placeholder of variable provided by not yet executed check script
 
 #define AUTARK_SCRIPT            "Autark"
 #define AUTARK_CACHE             "autark-cache"
@@ -21,6 +22,7 @@
 #define AUTARK_FETCHED_REG_DIST  ".autark-fetched-dist"
 #define AUTARK_FETCH_DEP         ".autark-fetch-dep"
 #define AUTARK_COMPILE_COMMANDS  ".compile_commands"
+#define AUTARK_MANIFEST          ".autark-manifest"
 
 #define AUTARK_ROOT_DIR_ENV          "AUTARK_ROOT_DIR"          // Project root directory
 #define AUTARK_CACHE_DIR_ENV         "AUTARK_CACHE_DIR"         // Project cache directory
@@ -29,9 +31,11 @@
                                                                 // unit executed
 #define AUTARK_INSTALL_SRC_DEPS_ENV "AUTARK_INSTALL_SRC_DEPS"   // Install src with deps.
 #define AUTARK_COMPILE_COMMANDS_ENV "AUTARK_COMPILE_COMMANDS"   // Path to compile commands file.
+#define AUTARK_EXECUTOR_ENV         "AUTARK_EXECUTOR"           // Executor of compile jobs.
 
 
 #define AUTARK_VERBOSE_ENV "AUTARK_VERBOSE"                     // Autark verbose env key
+#define AUTARK_WATCH_ENV   "AUTARK_WATCH"                       // Autark is restarted by watch mode
 
 #define UNIT_FLG_ROOT    0x01U // Project root unit
 #define UNIT_FLG_SRC_CWD 0x02U // Set project source dir as unit CWD
@@ -81,6 +85,7 @@ struct env {
     bool compile_commands;          // Generate compile_commands.json database.
     bool compile_commands_own;      // We own compile commands file.
     bool prepared;                  // Autark build prepared
+    bool watch;                     // Watch mode: rebuild on source changes
     struct xstr *options;           // Ask option values
   } project;
   struct {
@@ -97,12 +102,27 @@ struct env {
   struct {
     const char *extra_env_paths; // Extra PATH environment for any program spawn
   } spawn;
-  struct map  *map_path_to_unit; // Path to unit mapping
+  struct {
+    const char *cmd;  // Executor command compiling preprocessed sources, zero if sources compiled locally.
+    int jobs;         // Max number of compile jobs passed to executor in parallel.
+  } executor;
+  struct map  *map_path_to_unit; // Path id to unit mapping
+  struct {
+    struct map  *map;            // Normalized path to path id.
+    struct ulist entries;        // Interned paths indexed by id - 1 (struct pathid_entry).
+    uint32_t     stat_gen;       // Stat cache generation.
+  } pathids;
   struct ulist stack_units;      // Stack of nested unit contexts (struct unit_ctx)
   struct ulist units;            // All created units. (struct unit*)
+  unsigned     env_gen;          // Generation of units and process environment, incremented on any change.
   struct {
     struct xstr *log;
   } check;
+  struct {
+    struct map  *env;            // Process environment variables read by build (key -> value), zero if not recorded.
+    struct ulist procs;          // Recorded `@{...}` program outputs (char*)
+    unsigned     forced;         // Number of rules outdated on every build regardless of their dependencies.
+  } manifest;
 };
 
 extern struct env g_env;
@@ -135,6 +155,10 @@ void unit_env_set_val(struct unit*, const char *key, const char *val);
 
 void unit_env_set_node(struct unit*, const char *key, struct node *n, unsigned tag);
 
+/// Returns env item for the given key in the unit.
+/// Check script providing the key is executed on the first lookup.
+struct unit_env_item* unit_env_item(struct unit *u, const char *key);
+
 struct node* unit_env_get_node(struct unit *u, const char *key, unsigned *out_tag);
 
 const char* unit_env_get(struct node *n, const char *key);
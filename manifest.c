@@ -0,0 +1,296 @@
+#ifndef _AMALGAMATE_
+#include "manifest.h"
+#include "alloc.h"
+#include "deps.h"
+#include "env.h"
+#include "log.h"
+#include "map.h"
+#include "pathid.h"
+#include "paths.h"
+#include "spawn.h"
+#include "utils.h"
+#include "xstr.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+#define MANIFEST_FLG_ARGS 'a' // Autark command line
+#define MANIFEST_FLG_PROC 'p' // Output of `@{...}` program
+
+static void _manifest_path(char buf[PATH_MAX]) {
+  snprintf(buf, PATH_MAX, "%s/" AUTARK_MANIFEST, g_env.project.cache_dir);
+}
+
+void manifest_init(void) {
+  if (!g_env.manifest.env) {
+    g_env.manifest.env = map_create_str(map_kv_free);
+    g_env.manifest.procs.usize = sizeof(char*);
+  }
+}
+
+void manifest_dispose(void) {
+  if (g_env.manifest.env) {
+    map_destroy(g_env.manifest.env);
+    g_env.manifest.env = 0;
+  }
+  for (int i = 0; i < g_env.manifest.procs.num; ++i) {
+    free(*(char**) ulist_get(&g_env.manifest.procs, i));
+  }
+  ulist_destroy_keep(&g_env.manifest.procs);
+}
+
+const char* manifest_getenv(const char *key) {
+  const char *val = getenv(key);
+  if (g_env.manifest.env && !map_get(g_env.manifest.env, key)) {
+    map_put_str(g_env.manifest.env, key, xstrdup(val ? val : ""));
+  }
+  return val;
+}
+
+void manifest_env(const char *key) {
+  manifest_getenv(key);
+}
+
+struct _proc_ctx {
+  struct xstr *xargs;
+  int nargs;
+};
+
+static void _proc_arg_visitor(int num, const char *arg, void *d) {
+  struct _proc_ctx *ctx = d;
+  xstr_cat2(ctx->xargs, "\1", 1);
+  xstr_cat(ctx->xargs, arg);
+  ++ctx->nargs;
+}
+
+void manifest_proc(struct spawn *s, const char *output) {
+  if (!g_env.manifest.env) {
+    return;
+  }
+  char cwd[PATH_MAX];
+  if (!getcwd(cwd, sizeof(cwd))) {
+    akfatal(errno, 0, 0);
+  }
+  // <nargs>\1<cwd>\1<arg0>...\1<argN>\1<output>
+  struct _proc_ctx ctx = { .xargs = xstr_create_empty() };
+  spawn_visit_cmd(s, &ctx, _proc_arg_visitor);
+  struct xstr *xstr = xstr_create_empty();
+  xstr_printf(xstr, "%d\1%s%s\1%s", ctx.nargs, cwd, xstr_ptr(ctx.xargs), output ? output : "");
+  char *rec = xstr_destroy_keep_ptr(xstr);
+  ulist_push(&g_env.manifest.procs, &rec);
+  xstr_destroy(ctx.xargs);
+}
+
+static void _proc_stdout_handler(char *buf, size_t buflen, struct spawn *s) {
+  xstr_cat2(spawn_user_data(s), buf, buflen);
+}
+
+static void _proc_stderr_handler(char *buf, size_t buflen, struct spawn *s) {
+}
+
+static bool _manifest_proc_is_outdated(char *rec) {
+  int rc = 0;
+  char *argv[256];
+  char *rp = strchr(rec, '\1');
+  if (!rp) {
+    return true;
+  }
+  *rp++ = '\0';
+  int nargs = utils_strtol(rec, 10, &rc);
+  if (rc || nargs < 1 || nargs > sizeof(argv) / sizeof(argv[0])) {
+    return true;
+  }
+  const char *cwd = rp;
+  for (int i = 0; i <= nargs; ++i) {
+    rp = strchr(rp, '\1');
+    if (!rp) {
+      return true;
+    }
+    *rp++ = '\0';
+    if (i < nargs) {
+      argv[i] = rp;
+    }
+  }
+  const char *output = rp;
+
+  char prevcwd[PATH_MAX];
+  if (!getcwd(prevcwd, sizeof(prevcwd)) || chdir(cwd)) {
+    return true;
+  }
+  struct xstr *xstr = xstr_create_empty();
+  struct spawn *s = spawn_create(argv[0], xstr);
+  spawn_set_stdout_handler(s, _proc_stdout_handler);
+  spawn_set_stderr_handler(s, _proc_stderr_handler);
+  spawn_set_silent(s, true);
+  for (int i = 1; i < nargs; ++i) {
+    spawn_arg_add(s, argv[i]);
+  }
+  rc = spawn_do(s);
+  if (!rc && spawn_exit_code(s) != 0) {
+    rc = AK_ERROR_EXTERNAL_COMMAND;
+  }
+  spawn_destroy(s);
+  akcheck(chdir(prevcwd));
+
+  char *val = xstr_ptr(xstr);
+  for (int i = xstr_size(xstr) - 1; i >= 0 && utils_char_is_space(val[i]); --i) {
+    val[i] = '\0';
+  }
+  bool ret = rc || strcmp(val, output) != 0;
+  if (ret && g_env.verbose) {
+    akinfo("Build manifest: outdated output of %s", argv[0]);
+  }
+  xstr_destroy(xstr);
+  return ret;
+}
+
+static bool _manifest_is_outdated(struct deps *d, const char *args) {
+  struct akpath_stat st;
+  switch (d->type) {
+    case DEPS_TYPE_FILE:
+      if (  pathid_stat(pathid_intern_normalized(d->resource), &st)
+         || st.ftype == AKPATH_NOT_EXISTS
+         || st.mtime != d->serial) {
+        if (g_env.verbose) {
+          akinfo("Build manifest: outdated %s", d->resource);
+        }
+        return true;
+      }
+      return false;
+    case DEPS_TYPE_FILE_NOT_EXISTS:
+      if (pathid_stat(pathid_intern_normalized(d->resource), &st) || st.ftype != AKPATH_NOT_EXISTS) {
+        if (g_env.verbose) {
+          akinfo("Build manifest: outdated %s", d->resource);
+        }
+        return true;
+      }
+      return false;
+    case DEPS_TYPE_SYS_ENV: {
+      const char *val = getenv(d->alias);
+      if (strcmp(val ? val : "", d->resource) != 0) {
+        if (g_env.verbose) {
+          akinfo("Build manifest: outdated env %s", d->alias);
+        }
+        return true;
+      }
+      return false;
+    }
+    case DEPS_TYPE_NODE_VALUE:
+      if (d->flags == MANIFEST_FLG_ARGS) {
+        if (strcmp(d->resource, args) != 0) {
+          if (g_env.verbose) {
+            akinfo("Build manifest: command line changed");
+          }
+          return true;
+        }
+        return false;
+      } else if (d->flags == MANIFEST_FLG_PROC) {
+        return _manifest_proc_is_outdated((char*) d->resource);
+      }
+      return true;
+    default:
+      return true;
+  }
+}
+
+bool manifest_check(const char *args) {
+  char path[PATH_MAX];
+  _manifest_path(path);
+  int64_t ts = utils_current_time_ms();
+
+  struct deps d;
+  if (deps_open(path, DEPS_OPEN_READONLY, &d)) {
+    deps_close(&d);
+    return false;
+  }
+  bool ret = false;
+  int num = 0;
+  while (deps_cur_next(&d)) {
+    if (_manifest_is_outdated(&d, args)) {
+      ret = false;
+      break;
+    }
+    ret = true;
+    ++num;
+  }
+  deps_close(&d);
+
+  if (ret) {
+    if (g_env.verbose) {
+      akinfo("Build manifest: %d entries checked in %" PRId64 "ms", num, utils_current_time_ms() - ts);
+    }
+  } else {
+    unlink(path);
+  }
+  return ret;
+}
+
+static void _manifest_add_path(struct deps *d, uint32_t id) {
+  const struct pathid_entry *e = pathid_entry(id);
+  struct akpath_stat st;
+  if (pathid_stat(id, &st) || st.ftype == AKPATH_NOT_EXISTS) {
+    deps_add(d, DEPS_TYPE_FILE_NOT_EXISTS, 0, e->path, 0);
+  } else if (st.ftype != AKPATH_TYPE_DIR) {
+    deps_add(d, DEPS_TYPE_FILE, 0, e->path, 0);
+  }
+}
+
+void manifest_save(struct sctx *s, const char *args) {
+  char path[PATH_MAX], tmp[PATH_MAX];
+  _manifest_path(path);
+  if (g_env.manifest.forced || !g_env.manifest.env) {
+    unlink(path);
+    return;
+  }
+  // Files may be changed by the build
+  pathid_stat_reset();
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+  struct deps d;
+  int rc = deps_open(tmp, DEPS_OPEN_TRUNCATE, &d);
+  if (rc) {
+    akfatal(rc, "Failed to open build manifest: %s", tmp);
+  }
+  deps_add(&d, DEPS_TYPE_NODE_VALUE, MANIFEST_FLG_ARGS, args, 0);
+
+  struct map_iter it;
+  map_iter_init(g_env.manifest.env, &it);
+  while (map_iter_next(&it)) {
+    deps_add_sys_env(&d, 0, it.key, it.val);
+  }
+
+  // Project scripts and products
+  for (int i = 0; i < g_env.units.num; ++i) {
+    struct unit *unit = *(struct unit**) ulist_get(&g_env.units, i);
+    if (path_is_file(unit->source_path)) {
+      pathid_stat(pathid_intern(unit->source_path), &(struct akpath_stat) { 0 });
+    }
+  }
+  map_iter_init(s->products, &it);
+  while (map_iter_next(&it)) {
+    pathid_stat((uint32_t) (uintptr_t) it.key, &(struct akpath_stat) { 0 });
+  }
+
+  // All files checked by build
+  for (uint32_t id = 1; id <= g_env.pathids.entries.num; ++id) {
+    const struct pathid_entry *e = pathid_entry(id);
+    if (e->flags & PATHID_FLG_STAT) {
+      _manifest_add_path(&d, id);
+    }
+  }
+
+  for (int i = 0; i < g_env.manifest.procs.num; ++i) {
+    deps_add(&d, DEPS_TYPE_NODE_VALUE, MANIFEST_FLG_PROC, *(char**) ulist_get(&g_env.manifest.procs, i), 0);
+  }
+
+  deps_close(&d);
+  rc = utils_rename_file(tmp, path);
+  if (rc) {
+    akfatal(rc, "Rename failed of %s to %s", tmp, path);
+  }
+}
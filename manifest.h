@@ -0,0 +1,40 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#ifndef _AMALGAMATE_
+#include "script.h"
+#include "spawn.h"
+
+#include <stdbool.h>
+#endif
+
+/// Whole build manifest.
+/// Saved in the project cache dir after a successful build which found all rules up to date.
+/// It holds everything that build has verified: checked files and products, project scripts,
+/// process environment variables, `@{...}` command outputs and autark command line.
+/// The next invocation checks the manifest first and skips evaluation of scripts if nothing is changed.
+
+/// Starts recording of build inputs.
+void manifest_init(void);
+
+/// Releases recorded build inputs.
+void manifest_dispose(void);
+
+/// Returns true if the manifest saved by the previous build is valid for the given command line.
+/// Outdated manifest is removed.
+bool manifest_check(const char *args);
+
+/// Saves manifest at the end of successful build, file stats are taken after the build.
+/// Manifest is not saved if build has rules outdated on every build.
+void manifest_save(struct sctx*, const char *args);
+
+/// Returns process environment variable. Lookup is recorded in the manifest.
+const char* manifest_getenv(const char *key);
+
+/// Records the value of process environment variable before it is changed by autark.
+void manifest_env(const char *key);
+
+/// Records the output of `@{...}` program executed in the current directory.
+void manifest_proc(struct spawn*, const char *output);
+
+#endif
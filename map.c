@@ -3,31 +3,56 @@
 #include "log.h"
 #include "alloc.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <stddef.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #endif
 
-#define MIN_BUCKETS 64
-#define STEPS       4
+// Open addressing hash map with per slot control bytes (swiss table layout).
+// Each slot has a control byte: EMPTY, DELETED or seven low bits of the key hash.
+// Lookup scans a group of control bytes at once (SSE2 or 64-bit SWAR),
+// keys are compared only for slots with matched hash bits.
+
+#define MAP_CTRL_EMPTY   ((uint8_t) 0x80)
+#define MAP_CTRL_DELETED ((uint8_t) 0xFE)
+
+#define MAP_MIN_CAPACITY 16
+
+#if defined(__SSE2__)
+#define MAP_GROUP_WIDTH 16
+#define MAP_MASK_SHIFT  0
+typedef uint32_t map_mask_t;
+#else
+#define MAP_GROUP_WIDTH 8
+#define MAP_MASK_SHIFT  3
+typedef uint64_t map_mask_t;
+#endif
 
-struct _map_entry {
-  void    *key;
-  void    *val;
-  uint32_t hash;
+enum _map_kind {
+  MAP_KIND_CUSTOM = 0,
+  MAP_KIND_STR,
+  MAP_KIND_INT, // Integer key stored as pointer value
+  MAP_KIND_U64, // Boxed uint64_t key
 };
 
-struct _map_bucket {
-  struct _map_entry *entries;
-  uint32_t      used;
-  uint32_t      total;
+struct _map_slot {
+  void *key;
+  void *val;
 };
 
 struct map {
-  uint32_t       count;
-  uint32_t       buckets_mask;
-  struct _map_bucket *buckets;
+  uint32_t count;
+  uint32_t mask;        // Capacity - 1
+  uint32_t growth_left; // Number of inserts allowed before rehash
+  uint8_t *ctrl;        // capacity + MAP_GROUP_WIDTH control bytes, the tail mirrors the head
+  struct _map_slot *slots;
+  enum _map_kind    kind;
 
   int      (*cmp_fn)(const void*, const void*);
   uint32_t (*hash_key_fn)(const void*);
@@ -45,10 +70,6 @@ static void _map_noop_uint64_kv_free(void *key, void *val) {
   }
 }
 
-static inline uint32_t _map_n_buckets(struct map *hm) {
-  return hm->buckets_mask + 1;
-}
-
 static int _map_ptr_cmp(const void *v1, const void *v2) {
   return v1 > v2 ? 1 : v1 < v2 ? -1 : 0;
 }
@@ -91,8 +112,12 @@ static inline uint32_t _map_hash_uint64(uint64_t x) {
 }
 
 static inline uint32_t _map_hash_uint64_key(const void *key) {
-  uint64_t lv = 0;
-  memcpy(&lv, key, sizeof(void*));
+  uint64_t lv;
+  if (sizeof(uintptr_t) >= sizeof(uint64_t)) {
+    lv = (uintptr_t) key; // Key is stored as pointer value
+  } else {
+    memcpy(&lv, key, sizeof(lv));
+  }
   return _map_hash_uint64(lv);
 }
 
@@ -100,113 +125,235 @@ static inline uint32_t _map_hash_uint32_key(const void *key) {
   return _map_hash_uint32((uintptr_t) key);
 }
 
-static inline uint32_t _map_hash_buf_key(const void *key) {
-  const char *str = key;
-  uint32_t hash = 2166136261U;
-  while (*str) {
-    hash ^= (uint8_t) (*str);
-    hash *= 16777619U;
-    str++;
+static inline uint64_t _map_read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t _map_mix64(uint64_t a, uint64_t b) {
+  // Folded 64x64 multiply, portable variant of wyhash mum()
+  uint64_t ha = a >> 32, la = (uint32_t) a, hb = b >> 32, lb = (uint32_t) b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  return lo ^ hi;
+}
+
+/// Word at a time string hash in the spirit of wyhash.
+static inline uint32_t _map_hash_str(const char *str) {
+  const uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL;
+  const uint8_t *p = (const uint8_t*) str;
+  size_t len = strlen(str);
+  uint64_t h = s0 ^ len;
+  for ( ; len >= 16; len -= 16, p += 16) {
+    h = _map_mix64(_map_read64(p) ^ s1, _map_read64(p + 8) ^ h);
+  }
+  if (len >= 8) {
+    h = _map_mix64(_map_read64(p) ^ s1, h);
+    p += 8;
+    len -= 8;
   }
-  return hash;
+  uint64_t tail = 0;
+  for (size_t i = 0; i < len; ++i) {
+    tail |= (uint64_t) p[i] << (8 * i);
+  }
+  h = _map_mix64(tail ^ s1, h ^ s0);
+  return (uint32_t) (h ^ (h >> 32));
 }
 
-static struct _map_entry* _map_entry_add(struct map *hm, void *key, uint32_t hash) {
-  struct _map_entry *entry;
-  struct _map_bucket *bucket = hm->buckets + (hash & hm->buckets_mask);
+static uint32_t _map_hash_str_key(const void *key) {
+  return _map_hash_str(key);
+}
 
-  if (bucket->used + 1 >= bucket->total) {
-    if (UINT32_MAX - bucket->total < STEPS) {
-      akfatal(AK_ERROR_OVERFLOW, 0, 0, 0);
-    }
-    uint32_t new_total = bucket->total + STEPS;
-    struct _map_entry *new_entries = xrealloc(bucket->entries, new_total * sizeof(new_entries[0]));
-    bucket->entries = new_entries;
-    bucket->total = new_total;
-  }
-  entry = bucket->entries;
-  for (struct _map_entry *end = entry + bucket->used; entry < end; ++entry) {
-    if ((hash == entry->hash) && (hm->cmp_fn(key, entry->key) == 0)) {
-      return entry;
-    }
+static inline uint32_t _map_h1(uint32_t hash) {
+  return hash >> 7;
+}
+
+static inline uint8_t _map_h2(uint32_t hash) {
+  return hash & 0x7f;
+}
+
+static inline unsigned _map_mask_first(map_mask_t m) {
+#ifdef __GNUC__
+#if defined(__SSE2__)
+  return __builtin_ctz(m) >> MAP_MASK_SHIFT;
+#else
+  return __builtin_ctzll(m) >> MAP_MASK_SHIFT;
+#endif
+#else
+  unsigned i = 0;
+  while (!(m & 1)) {
+    m >>= 1;
+    ++i;
   }
-  ++bucket->used;
-  ++hm->count;
+  return i >> MAP_MASK_SHIFT;
+#endif
+}
 
-  entry->hash = hash;
-  entry->key = 0;
-  entry->val = 0;
+#if defined(__SSE2__)
 
-  return entry;
+static inline map_mask_t _map_group_match(const uint8_t *g, uint8_t h2) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) g);
+  return (map_mask_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) h2)));
 }
 
-static struct _map_entry* _map_entry_find(struct map *hm, const void *key, uint32_t hash) {
-  struct _map_bucket *bucket = hm->buckets + (hash & hm->buckets_mask);
-  struct _map_entry *entry = bucket->entries;
-  for (struct _map_entry *end = entry + bucket->used; entry < end; ++entry) {
-    if (hash == entry->hash && hm->cmp_fn(key, entry->key) == 0) {
-      return entry;
-    }
+static inline map_mask_t _map_group_match_empty(const uint8_t *g) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) g);
+  return (map_mask_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) MAP_CTRL_EMPTY)));
+}
+
+static inline map_mask_t _map_group_match_free(const uint8_t *g) {
+  // Control bytes with high bit set are either EMPTY or DELETED
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) g);
+  return (map_mask_t) _mm_movemask_epi8(ctrl);
+}
+
+#else
+
+#define MAP_LSBS 0x0101010101010101ULL
+#define MAP_MSBS 0x8080808080808080ULL
+
+static inline uint64_t _map_group_load(const uint8_t *g) {
+  uint64_t v = _map_read64(g);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+static inline map_mask_t _map_group_match(const uint8_t *g, uint8_t h2) {
+  // May report false positive bytes, they are filtered out by key comparison
+  uint64_t x = _map_group_load(g) ^ (MAP_LSBS * h2);
+  return (x - MAP_LSBS) & ~x & MAP_MSBS;
+}
+
+static inline map_mask_t _map_group_match_empty(const uint8_t *g) {
+  uint64_t c = _map_group_load(g);
+  return c & (~c << 6) & MAP_MSBS;
+}
+
+static inline map_mask_t _map_group_match_free(const uint8_t *g) {
+  return _map_group_load(g) & MAP_MSBS;
+}
+
+#endif
+
+static inline bool _map_key_eq(struct map *hm, const void *key, const void *skey) {
+  switch (hm->kind) {
+    case MAP_KIND_STR:
+      return strcmp(key, skey) == 0;
+    case MAP_KIND_INT:
+      return key == skey;
+    case MAP_KIND_U64:
+      return memcmp(key, skey, sizeof(uint64_t)) == 0;
+    default:
+      return hm->cmp_fn(key, skey) == 0;
   }
-  return 0;
 }
 
-static void _map_rehash(struct map *hm, uint32_t num_buckets) {
-  struct _map_bucket *buckets = xcalloc(num_buckets, sizeof(*buckets));
-  struct _map_bucket *bucket,
-                *bucket_end = hm->buckets + _map_n_buckets(hm);
-
-  struct map hm_copy = *hm;
-  hm_copy.count = 0;
-  hm_copy.buckets_mask = num_buckets - 1;
-  hm_copy.buckets = buckets;
-
-  for (bucket = hm->buckets; bucket < bucket_end; ++bucket) {
-    struct _map_entry *entry_old = bucket->entries;
-    if (entry_old) {
-      struct _map_entry *entry_old_end = entry_old + bucket->used;
-      for ( ; entry_old < entry_old_end; ++entry_old) {
-        struct _map_entry *entry_new = _map_entry_add(&hm_copy, entry_old->key, entry_old->hash);
-        entry_new->key = entry_old->key;
-        entry_new->val = entry_old->val;
+static inline uint32_t _map_hash(struct map *hm, const void *key) {
+  switch (hm->kind) {
+    case MAP_KIND_STR:
+      return _map_hash_str(key);
+    default:
+      return hm->hash_key_fn(key);
+  }
+}
+
+static inline void _map_ctrl_set(struct map *hm, uint32_t idx, uint8_t c) {
+  hm->ctrl[idx] = c;
+  if (idx < MAP_GROUP_WIDTH) {
+    hm->ctrl[hm->mask + 1 + idx] = c;
+  }
+}
+
+static inline uint32_t _map_max_load(uint32_t capacity) {
+  return capacity - capacity / 8;
+}
+
+static void _map_alloc(struct map *hm, uint32_t capacity) {
+  hm->mask = capacity - 1;
+  hm->ctrl = xmalloc(capacity + MAP_GROUP_WIDTH);
+  memset(hm->ctrl, MAP_CTRL_EMPTY, capacity + MAP_GROUP_WIDTH);
+  hm->slots = xmalloc(sizeof(hm->slots[0]) * capacity);
+  hm->growth_left = _map_max_load(capacity);
+}
+
+/// Find slot index holding the specified key. Returns -1 if not found.
+static int64_t _map_find(struct map *hm, const void *key, uint32_t hash) {
+  uint8_t h2 = _map_h2(hash);
+  uint32_t pos = _map_h1(hash) & hm->mask;
+  for (uint32_t step = MAP_GROUP_WIDTH; ; step += MAP_GROUP_WIDTH) {
+    const uint8_t *g = hm->ctrl + pos;
+    for (map_mask_t m = _map_group_match(g, h2); m; m &= m - 1) {
+      uint32_t idx = (pos + _map_mask_first(m)) & hm->mask;
+      if (hm->ctrl[idx] == h2 && _map_key_eq(hm, key, hm->slots[idx].key)) {
+        return idx;
       }
     }
+    if (_map_group_match_empty(g)) {
+      return -1;
+    }
+    pos = (pos + step) & hm->mask;
   }
+}
 
-  for (bucket = hm->buckets; bucket < bucket_end; ++bucket) {
-    free(bucket->entries);
+/// Find first free (empty or deleted) slot for the given hash.
+static uint32_t _map_find_free(struct map *hm, uint32_t hash) {
+  uint32_t pos = _map_h1(hash) & hm->mask;
+  for (uint32_t step = MAP_GROUP_WIDTH; ; step += MAP_GROUP_WIDTH) {
+    map_mask_t m = _map_group_match_free(hm->ctrl + pos);
+    if (m) {
+      return (pos + _map_mask_first(m)) & hm->mask;
+    }
+    pos = (pos + step) & hm->mask;
   }
-  free(hm->buckets);
-
-  hm->buckets = buckets;
-  hm->buckets_mask = num_buckets - 1;
-  return;
 }
 
-static void _map_entry_remove(struct map *hm, struct _map_bucket *bucket, struct _map_entry *entry) {
-  hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : entry->key, entry->val);
-  if (bucket->used > 1) {
-    struct _map_entry *entry_last = bucket->entries + bucket->used - 1;
-    if (entry != entry_last) {
-      memcpy(entry, entry_last, sizeof(*entry));
+static void _map_rehash(struct map *hm, uint32_t capacity) {
+  uint8_t *ctrl = hm->ctrl;
+  struct _map_slot *slots = hm->slots;
+  uint32_t old_capacity = hm->mask + 1;
+
+  _map_alloc(hm, capacity);
+  for (uint32_t i = 0; i < old_capacity; ++i) {
+    if (!(ctrl[i] & MAP_CTRL_EMPTY)) {
+      struct _map_slot *s = slots + i;
+      uint32_t hash = _map_hash(hm, s->key);
+      uint32_t idx = _map_find_free(hm, hash);
+      _map_ctrl_set(hm, idx, _map_h2(hash));
+      hm->slots[idx] = *s;
     }
   }
-  --bucket->used;
-  --hm->count;
+  hm->growth_left -= hm->count;
+  free(ctrl);
+  free(slots);
+}
 
-  if ((hm->buckets_mask > MIN_BUCKETS - 1) && (hm->count < hm->buckets_mask / 2)) {
-    _map_rehash(hm, _map_n_buckets(hm) / 2);
-  } else {
-    uint32_t steps_used = bucket->used / STEPS;
-    uint32_t steps_total = bucket->total / STEPS;
-    if (steps_used + 1 < steps_total) {
-      struct _map_entry *entries_new = realloc(bucket->entries, ((size_t) steps_used + 1) * STEPS * sizeof(entries_new[0]));
-      if (entries_new) {
-        bucket->entries = entries_new;
-        bucket->total = (steps_used + 1) * STEPS;
-      }
+static void _map_reserve_one(struct map *hm) {
+  if (hm->growth_left > 0) {
+    return;
+  }
+  uint32_t capacity = hm->mask + 1;
+  if (hm->count >= _map_max_load(capacity) / 2) {
+    if (capacity > UINT32_MAX / 2) {
+      akfatal(AK_ERROR_OVERFLOW, 0, 0, 0);
     }
+    capacity *= 2;
   }
+  // Otherwise table is full of tombstones, rehash in place
+  _map_rehash(hm, capacity);
+}
+
+static void _map_slot_remove(struct map *hm, uint32_t idx) {
+  struct _map_slot *s = hm->slots + idx;
+  hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : s->key, s->val);
+  // Tombstone keeps probe sequences passing over this slot valid, it is dropped on rehash
+  _map_ctrl_set(hm, idx, MAP_CTRL_DELETED);
+  --hm->count;
 }
 
 void map_kv_free(void *key, void *val) {
@@ -233,27 +380,25 @@ struct map* map_create(
   }
 
   struct map *hm = xmalloc(sizeof(*hm));
-  hm->buckets = xcalloc(MIN_BUCKETS, sizeof(hm->buckets[0]));
   hm->cmp_fn = cmp_fn;
   hm->hash_key_fn = hash_key_fn;
   hm->kv_free_fn = kv_free_fn;
-  hm->buckets_mask = MIN_BUCKETS - 1;
   hm->count = 0;
+  hm->kind = MAP_KIND_CUSTOM;
   hm->int_key_as_pointer_value = 0;
+  _map_alloc(hm, MAP_MIN_CAPACITY);
   return hm;
 }
 
 void map_destroy(struct map *hm) {
   if (hm) {
-    for (struct _map_bucket *b = hm->buckets, *be = hm->buckets + _map_n_buckets(hm); b < be; ++b) {
-      if (b->entries) {
-        for (struct _map_entry *e = b->entries, *ee = b->entries + b->used; e < ee; ++e) {
-          hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : e->key, e->val);
-        }
-        free(b->entries);
+    for (uint32_t i = 0; i <= hm->mask; ++i) {
+      if (!(hm->ctrl[i] & MAP_CTRL_EMPTY)) {
+        hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : hm->slots[i].key, hm->slots[i].val);
       }
     }
-    free(hm->buckets);
+    free(hm->ctrl);
+    free(hm->slots);
     free(hm);
   }
 }
@@ -266,6 +411,9 @@ struct map* map_create_u64(void (*kv_free_fn)(void*, void*)) {
   if (hm) {
     if (sizeof(uintptr_t) >= sizeof(uint64_t)) {
       hm->int_key_as_pointer_value = 1;
+      hm->kind = MAP_KIND_INT;
+    } else {
+      hm->kind = MAP_KIND_U64;
     }
   }
   return hm;
@@ -275,23 +423,38 @@ struct map* map_create_u32(void (*kv_free_fn)(void*, void*)) {
   struct map *hm = map_create(_map_uint32_cmp, _map_hash_uint32_key, kv_free_fn);
   if (hm) {
     hm->int_key_as_pointer_value = 1;
+    hm->kind = MAP_KIND_INT;
   }
   return hm;
 }
 
 struct map* map_create_str(void (*kv_free_fn)(void*, void*)) {
-  return map_create((int (*)(const void*, const void*)) strcmp, _map_hash_buf_key, kv_free_fn);
+  struct map *hm = map_create((int (*)(const void*, const void*)) strcmp, _map_hash_str_key, kv_free_fn);
+  if (hm) {
+    hm->kind = MAP_KIND_STR;
+  }
+  return hm;
 }
 
 void map_put(struct map *hm, void *key, void *val) {
-  uint32_t hash = hm->hash_key_fn(key);
-  struct _map_entry *entry = _map_entry_add(hm, key, hash);
-  hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : entry->key, entry->val);
-  entry->key = key;
-  entry->val = val;
-  if (hm->count > hm->buckets_mask) {
-    _map_rehash(hm, _map_n_buckets(hm) * 2);
+  uint32_t hash = _map_hash(hm, key);
+  int64_t idx = _map_find(hm, key, hash);
+  if (idx >= 0) {
+    struct _map_slot *s = hm->slots + idx;
+    hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : s->key, s->val);
+    s->key = key;
+    s->val = val;
+    return;
   }
+  _map_reserve_one(hm);
+  idx = _map_find_free(hm, hash);
+  if (hm->ctrl[idx] == MAP_CTRL_EMPTY) {
+    --hm->growth_left;
+  }
+  _map_ctrl_set(hm, idx, _map_h2(hash));
+  hm->slots[idx].key = key;
+  hm->slots[idx].val = val;
+  ++hm->count;
 }
 
 void map_put_u32(struct map *hm, uint32_t key, void *val) {
@@ -318,11 +481,9 @@ void map_put_str_no_copy(struct map *hm, const char *key, void *val) {
 }
 
 int map_remove(struct map *hm, const void *key) {
-  uint32_t hash = hm->hash_key_fn(key);
-  struct _map_bucket *bucket = hm->buckets + (hash & hm->buckets_mask);
-  struct _map_entry *entry = _map_entry_find(hm, key, hash);
-  if (entry) {
-    _map_entry_remove(hm, bucket, entry);
+  int64_t idx = _map_find(hm, key, _map_hash(hm, key));
+  if (idx >= 0) {
+    _map_slot_remove(hm, idx);
     return 1;
   } else {
     return 0;
@@ -342,10 +503,9 @@ int map_remove_u32(struct map *hm, uint32_t key) {
 }
 
 void* map_get(struct map *hm, const void *key) {
-  uint32_t hash = hm->hash_key_fn(key);
-  struct _map_entry *entry = _map_entry_find(hm, key, hash);
-  if (entry) {
-    return entry->val;
+  int64_t idx = _map_find(hm, key, _map_hash(hm, key));
+  if (idx >= 0) {
+    return hm->slots[idx].val;
   } else {
     return 0;
   }
@@ -371,57 +531,37 @@ void map_clear(struct map *hm) {
   if (!hm) {
     return;
   }
-  for (struct _map_bucket *b = hm->buckets, *be = hm->buckets + _map_n_buckets(hm); b < be; ++b) {
-    for (struct _map_entry *e = b->entries, *ee = b->entries + b->used; e < ee; ++e) {
-      hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : e->key, e->val);
-    }
-    free(b->entries);
-    b->used = 0;
-    b->total = 0;
-    b->entries = 0;
-  }
-  if (_map_n_buckets(hm) > MIN_BUCKETS) {
-    struct _map_bucket *buckets_new = realloc(hm->buckets, sizeof(buckets_new[0]) * MIN_BUCKETS);
-    if (buckets_new) {
-      memset(buckets_new, 0, sizeof(buckets_new[0]) * MIN_BUCKETS);
-      hm->buckets = buckets_new;
-      hm->buckets_mask = MIN_BUCKETS - 1;
+  for (uint32_t i = 0; i <= hm->mask; ++i) {
+    if (!(hm->ctrl[i] & MAP_CTRL_EMPTY)) {
+      hm->kv_free_fn(hm->int_key_as_pointer_value ? 0 : hm->slots[i].key, hm->slots[i].val);
     }
   }
+  free(hm->ctrl);
+  free(hm->slots);
   hm->count = 0;
+  _map_alloc(hm, MAP_MIN_CAPACITY);
 }
 
 void map_iter_init(struct map *hm, struct map_iter *iter) {
   iter->hm = hm;
   iter->entry = -1;
-  iter->bucket = 0;
   iter->key = 0;
   iter->val = 0;
 }
 
 int map_iter_next(struct map_iter *iter) {
-  if (!iter->hm) {
+  struct map *hm = iter->hm;
+  if (!hm) {
     return 0;
   }
-  struct _map_entry *entry;
-  struct _map_bucket *bucket = iter->hm->buckets + iter->bucket;
-
-  ++iter->entry;
-  if ((uint32_t) iter->entry >= bucket->used) {
-    uint32_t n = _map_n_buckets(iter->hm);
-    iter->entry = 0;
-    for (++iter->bucket; iter->bucket < n; ++iter->bucket) {
-      bucket = iter->hm->buckets + iter->bucket;
-      if (bucket->used > 0) {
-        break;
-      }
-    }
-    if (iter->bucket >= n) {
-      return 0;
+  for (uint32_t i = iter->entry + 1; i <= hm->mask; ++i) {
+    if (!(hm->ctrl[i] & MAP_CTRL_EMPTY)) {
+      iter->entry = i;
+      iter->key = hm->slots[i].key;
+      iter->val = hm->slots[i].val;
+      return 1;
     }
   }
-  entry = bucket->entries + iter->entry;
-  iter->key = entry->key;
-  iter->val = entry->val;
-  return 1;
+  iter->entry = hm->mask;
+  return 0;
 }
@@ -12,7 +12,6 @@ struct map_iter {
   struct map *hm;
   const void *key;
   const void *val;
-  uint32_t    bucket;
   int32_t     entry;
 };
 
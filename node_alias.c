@@ -0,0 +1,28 @@
+#ifndef _AMALGAMATE_
+#include "script.h"
+#include "log.h"
+#include "map.h"
+#endif
+
+static void _alias_init(struct node *n) {
+  const char *name = node_value(n->child);
+  if (!name || *name == '\0') {
+    node_warn(n, "No name specified for 'alias' directive");
+    return;
+  }
+  struct node *prev = map_get(n->ctx->aliases, name);
+  if (prev) {
+    node_fatal(AK_ERROR_SCRIPT, n, "Alias '%s' is already defined at: %s", name, prev->name);
+  }
+  map_put_str(n->ctx->aliases, name, n);
+}
+
+static const struct node_ops _alias_ops = {
+  .init = _alias_init,
+};
+
+int node_alias_setup(struct node *n) {
+  n->flags |= NODE_FLG_NO_CWD;
+  n->ops = &_alias_ops;
+  return 0;
+}
@@ -0,0 +1,288 @@
+#ifndef _AMALGAMATE_
+#include "script.h"
+#include "alloc.h"
+#include "env.h"
+#include "log.h"
+#include "map.h"
+#include "paths.h"
+#include "pool.h"
+#include "spawn.h"
+#include "utils.h"
+
+#include <string.h>
+#include <unistd.h>
+#endif
+
+struct _archive_ctx {
+  struct pool *pool;
+  struct node *n;
+  struct node *n_lib;
+  struct node *n_objects;
+  struct node *n_ar;
+  struct node *n_consumes;
+  const char  *lib;       // Archive file
+  const char  *ar;        // Archiver
+  struct ulist objects;   // Members of archive relative to the unit cache dir (char*)
+  struct ulist consumes;  // char*
+  bool thin;              // Produce thin archive holding only paths of members
+  bool ar_env;            // Archiver is looked up in ${AR}
+};
+
+// Members are replaced by basename, so archive with the same basename
+// of several members can't be updated incrementally.
+static bool _archive_members_are_unique(struct _archive_ctx *ctx) {
+  bool ret = true;
+  struct map *names = map_create_str(0);
+  for (int i = 0; i < ctx->objects.num && ret; ++i) {
+    const char *obj = *(char**) ulist_get(&ctx->objects, i);
+    const char *name = strrchr(obj, '/');
+    name = name ? name + 1 : obj;
+    if (map_get(names, name)) {
+      ret = false;
+    } else {
+      map_put_str_no_copy(names, name, (void*) 1);
+    }
+  }
+  map_destroy(names);
+  return ret;
+}
+
+static void _archive_do(struct _archive_ctx *ctx, struct ulist *members) {
+  struct node *n = ctx->n;
+  struct spawn *s = spawn_create(ctx->ar, ctx);
+  spawn_arg_add(s, ctx->thin ? "rcsT" : "rcs");
+  spawn_arg_add(s, ctx->lib);
+  for (int i = 0; i < members->num; ++i) {
+    spawn_arg_add(s, *(char**) ulist_get(members, i));
+  }
+  int rc = spawn_do(s);
+  if (rc) {
+    node_fatal(rc, n, "%s", ctx->ar);
+  } else {
+    int code = spawn_exit_code(s);
+    if (code != 0) {
+      node_fatal(AK_ERROR_EXTERNAL_COMMAND, n, "%s: %d", ctx->ar, code);
+    }
+  }
+  spawn_destroy(s);
+}
+
+static void _archive_on_resolve(struct node_resolve *r) {
+  struct _archive_ctx *ctx = r->user_data;
+  struct unit *unit = unit_peek();
+  struct ulist members = { .usize = sizeof(char*) };
+
+  // Only changed members are replaced in the existing archive,
+  // any other outdated dependency (objects list, archiver, consumed files) rebuilds it from scratch.
+  bool full = r->resolve_outdated.num == 0 || access(ctx->lib, F_OK) != 0 || !_archive_members_are_unique(ctx);
+  for (int i = 0; i < r->resolve_outdated.num && !full; ++i) {
+    struct resolve_outdated *u = ulist_get(&r->resolve_outdated, i);
+    if (u->flags != 'o') {
+      full = true;
+    } else {
+      char *obj = path_relativize_cwd(unit->cache_dir, u->path, unit->cache_dir);
+      ulist_push(&members, &obj);
+    }
+  }
+  if (full) {
+    for (int i = 0; i < members.num; ++i) {
+      free(*(char**) ulist_get(&members, i));
+    }
+    ulist_clear(&members);
+    for (int i = 0; i < ctx->objects.num; ++i) {
+      char *obj = xstrdup(*(char**) ulist_get(&ctx->objects, i));
+      ulist_push(&members, &obj);
+    }
+    unlink(ctx->lib);
+  }
+
+  if (g_env.check.log) {
+    xstr_printf(g_env.check.log, "%s: archive %s members=%d\n", ctx->n->name, full ? "full" : "update", members.num);
+  }
+  _archive_do(ctx, &members);
+
+  struct deps deps;
+  int rc = deps_open(r->deps_path_tmp, 0, &deps);
+  if (rc) {
+    node_fatal(rc, ctx->n, "Failed to open dependency file: %s", r->deps_path_tmp);
+  }
+  for (int i = 0; i < r->node_val_deps.num; ++i) {
+    struct node *nv = *(struct node**) ulist_get(&r->node_val_deps, i);
+    const char *val = node_value(nv);
+    if (val) {
+      deps_add(&deps, DEPS_TYPE_NODE_VALUE, 0, val, i);
+    }
+  }
+  if (ctx->ar_env) {
+    const char *ar = node_env_get(ctx->n, "AR");
+    deps_add_env(&deps, 0, "AR", ar ? ar : "");
+  }
+  for (int i = 0; i < ctx->consumes.num; ++i) {
+    const char *path = *(const char**) ulist_get(&ctx->consumes, i);
+    deps_add(&deps, DEPS_TYPE_FILE, 0, path, 0);
+  }
+  for (int i = 0; i < ctx->objects.num; ++i) {
+    const char *path = *(const char**) ulist_get(&ctx->objects, i);
+    deps_add(&deps, DEPS_TYPE_FILE, 'o', path, 0);
+  }
+  node_products_add_as_deps(ctx->n, &deps);
+  deps_close(&deps);
+
+  for (int i = 0; i < members.num; ++i) {
+    free(*(char**) ulist_get(&members, i));
+  }
+  ulist_destroy_keep(&members);
+}
+
+static void _archive_on_object_resolved(const char *path, void *d) {
+  struct _archive_ctx *ctx = d;
+  struct unit *unit = unit_peek();
+  char *obj = path_relativize_cwd(unit->cache_dir, path, unit->cache_dir);
+  const char *p = pool_strdup(ctx->pool, obj);
+  ulist_push(&ctx->objects, &p);
+  free(obj);
+}
+
+static void _archive_on_consumed_resolved(const char *path_, void *d) {
+  struct _archive_ctx *ctx = d;
+  const char *path = pool_strdup(ctx->pool, path_);
+  ulist_push(&ctx->consumes, &path);
+}
+
+static void _archive_on_resolve_init(struct node_resolve *r) {
+  struct _archive_ctx *ctx = r->user_data;
+  ulist_clear(&ctx->objects);
+  ulist_clear(&ctx->consumes);
+
+  struct ulist paths = { .usize = sizeof(char*) };
+  const struct vlist *objects = node_list(ctx->n_objects);
+  for (size_t i = 0; objects && i < objects->num; ++i) {
+    const struct vlist_item *item = vlist_item(objects, i);
+    char *p = pool_strndup(r->pool, item->ptr, item->len);
+    ulist_push(&paths, &p);
+  }
+  node_consumes_resolve(r->n, 0, &paths, _archive_on_object_resolved, ctx);
+  ulist_destroy_keep(&paths);
+  if (ctx->n_consumes) {
+    node_consumes_resolve(r->n, ctx->n_consumes->child, 0, _archive_on_consumed_resolved, ctx);
+  }
+}
+
+static void _archive_build(struct node *n) {
+  struct _archive_ctx *ctx = n->impl;
+  struct node_resolve r = {
+    .n = n,
+    .path = n->vfile,
+    .user_data = ctx,
+    .on_init = _archive_on_resolve_init,
+    .on_resolve = _archive_on_resolve,
+    .node_val_deps = { .usize = sizeof(struct node*) }
+  };
+
+  if (node_is_value_may_be_dep_saved(ctx->n_ar, NODE_TYPE_VALUE)) {
+    ulist_push(&r.node_val_deps, &ctx->n_ar);
+  }
+  if (node_is_value_may_be_dep_saved(ctx->n_objects, NODE_TYPE_VALUE)) {
+    ulist_push(&r.node_val_deps, &ctx->n_objects);
+  }
+  if (node_is_value_may_be_dep_saved(ctx->n_lib, NODE_TYPE_VALUE)) {
+    ulist_push(&r.node_val_deps, &ctx->n_lib);
+  }
+
+  node_add_io_val_deps(n, &r.node_val_deps);
+  node_resolve(&r);
+}
+
+static void _archive_setup(struct node *n) {
+  struct _archive_ctx *ctx = n->impl;
+  const char *lib = node_value(ctx->n_lib);
+  if (!lib || *lib == '\0') {
+    node_fatal(AK_ERROR_SCRIPT, n, "No archive file specified");
+  }
+  ctx->lib = pool_strdup(ctx->pool, lib);
+  if (g_env.verbose) {
+    node_info(n, "Product: %s", ctx->lib);
+  }
+  node_product_add(n, ctx->lib, 0);
+
+  if (ctx->n_ar) {
+    const char *ar = node_value(ctx->n_ar);
+    if (ar && *ar != '\0') {
+      ctx->ar = pool_strdup(ctx->pool, ar);
+    }
+  }
+  if (!ctx->ar) {
+    ctx->ar_env = true;
+    const char *ar = node_env_get(n, "AR");
+    if (ar && *ar != '\0') {
+      ctx->ar = pool_strdup(ctx->pool, ar);
+      if (g_env.verbose) {
+        node_info(n, "Found '%s' archiver in ${AR}", ctx->ar);
+      }
+    }
+  }
+  if (!ctx->ar) {
+    ctx->ar = "ar";
+    node_warn(n, "Fallback archiver: %s", ctx->ar);
+  } else if (g_env.verbose) {
+    node_info(n, "Archiver: %s", ctx->ar);
+  }
+}
+
+static void _archive_init(struct node *n) {
+  struct _archive_ctx *ctx = n->impl;
+  for (struct node *nn = n->child; nn; nn = nn->next) {
+    if (nn->kw == NODE_KW_CONSUMES) {
+      ctx->n_consumes = nn;
+      continue;
+    } else if (nn->kw == NODE_KW_THIN_ARCHIVE && nn->type == NODE_TYPE_VALUE) {
+      ctx->thin = true;
+      continue;
+    }
+    if (!ctx->n_lib) {
+      ctx->n_lib = nn;
+      continue;
+    }
+    if (!ctx->n_objects) {
+      ctx->n_objects = nn;
+      continue;
+    }
+    if (!ctx->n_ar) {
+      ctx->n_ar = nn;
+    }
+  }
+  if (!ctx->n_objects) {
+    node_fatal(AK_ERROR_SCRIPT, n, "No archive members specified");
+  }
+}
+
+static void _archive_dispose(struct node *n) {
+  struct _archive_ctx *ctx = n->impl;
+  if (ctx) {
+    ulist_destroy_keep(&ctx->objects);
+    ulist_destroy_keep(&ctx->consumes);
+    pool_destroy(ctx->pool);
+  }
+}
+
+static const struct node_ops _archive_ops = {
+  .init = _archive_init,
+  .setup = _archive_setup,
+  .build = _archive_build,
+  .dispose = _archive_dispose,
+};
+
+int node_archive_setup(struct node *n) {
+  n->flags |= NODE_FLG_IN_CACHE;
+  n->ops = &_archive_ops;
+  struct pool *pool = pool_create_empty();
+  struct _archive_ctx *ctx = pool_alloc(pool, sizeof(*ctx));
+  *ctx = (struct _archive_ctx) {
+    .pool = pool,
+    .n = n,
+    .objects = { .usize = sizeof(char*) },
+    .consumes = { .usize = sizeof(char*) },
+  };
+  n->impl = ctx;
+  return 0;
+}
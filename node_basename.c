@@ -8,14 +8,8 @@
 #endif
 
 static const char* _basename_value(struct node *n) {
-  struct node_foreach *fe = node_find_parent_foreach(n);
-  if (fe) {
-    free(n->impl);
-    n->impl = 0;
-  }
-  if (n->impl) {
-    return n->impl;
-  }
+  free(n->impl);
+  n->impl = 0;
 
   const char *val = 0;
   const char *replace_ext = 0;
@@ -43,9 +37,14 @@ static void _basename_dispose(struct node *n) {
   free(n->impl);
 }
 
+static const struct node_ops _basename_ops = {
+  .value_get  = _basename_value,
+  .dispose    = _basename_dispose,
+  .value_memo = true,
+};
+
 int node_basename_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->value_get = _basename_value;
-  n->dispose = _basename_dispose;
+  n->ops = &_basename_ops;
   return 0;
 }
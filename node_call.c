@@ -157,9 +157,13 @@ static void _call_dispose(struct node *n) {
   }
 }
 
+static const struct node_ops _call_ops = {
+  .init    = _call_init,
+  .dispose = _call_dispose,
+};
+
 int node_call_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->init = _call_init;
-  n->dispose = _call_dispose;
+  n->ops = &_call_ops;
   return 0;
 }
@@ -12,6 +12,7 @@
 #include "map.h"
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <sys/wait.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -33,53 +34,69 @@ struct _cc_ctx {
   struct node *n_cc;
   struct node *n_consumes;
   struct node *n_objects;
+  struct node *n_pch;
+  struct node *n_unity;
+  struct node *n_batch;
+  struct node *n_modules;
   const char  *cc;
+  const char  *cc_env;      // Environment variable the compiler is looked up in
+  const char  *pch_header;  // Absolute path of header to be precompiled
+  const char  *pch_stub;    // Header stub included by compile commands
+  const char  *pch;         // Precompiled header file
   const char  *objskey;
+  const char  *scanner;     // Custom P1689 dependency scanner of C++20 modules
   struct ulist consumes;    // sizeof(char*)
+  struct ulist finished;    // Finished compile task processes (struct spawn*)
+  struct map  *outputs;     // Output buffers of running compile processes: struct spawn* -> struct xstr*
+  int batch;                // Max number of sources passed to single compiler invocation
+  bool modules;             // C++20 modules are enabled
+  bool remote;              // Preprocessed sources are compiled by executor
   int num_failed;
 };
 
 static void _cc_cdb_entry_add(struct node *n, struct spawn *s, const char *src, const char *tgt);
 
-static void _cc_deps_MMD_item_add(const char *item, struct node *n, struct deps *deps, const char *src) {
-  char buf[127];
-  char *p = strrchr(item, '.');
-  if (!p || p[1] == '\0') {
-    return;
-  }
-  ++p;
-  char *ext = utils_strncpy(buf, p, sizeof(buf));
-  if (*ext == 'c' || *ext == 'C' || *ext == 'm') {
-    // Skip source files
+struct _cc_deps_MMD_ctx {
+  struct deps *deps;
+  const char  *src;
+};
+
+static void _cc_deps_MMD_item_add(const char *item, void *d) {
+  struct _cc_deps_MMD_ctx *ctx = d;
+  if (strcmp(item, ctx->src) == 0 || strcmp(item, "|") == 0 || utils_endswith(item, ".c++m")) {
+    // Skip compiled source itself (files included by unity sources are tracked as dependencies),
+    // order-only separators and phony targets of modules imported by GCC.
     return;
   }
-  deps_add_alias(deps, 's', src, item);
+  deps_add_alias(ctx->deps, 's', ctx->src, item);
 }
 
-static void _cc_deps_MMD_add(struct node *n, struct deps *deps, const char *src, const char *obj) {
+// Visits prerequisites of the `target` listed in the compiler generated (-MMD) dependency file.
+static bool _cc_deps_MMD_visit(const char *dfile, const char *target, void *d, void (*visitor)(const char*, void*)) {
   char buf[MAX(2 * PATH_MAX, 8192)];
-  size_t len = strlen(obj);
-  utils_strncpy(buf, obj, sizeof(buf));
+  size_t len = strlen(target);
+  char *p;
 
-  char *p = strrchr(buf, '.');
-  akassert(p && p[1] != '\0');
-  p[1] = 'd';
-  p[2] = '\0';
-
-  FILE *f = fopen(buf, "r");
+  FILE *f = fopen(dfile, "r");
   if (!f) {
-    node_warn(n, "Failed to open compiler generated (-MMD) dependency file: %s", buf);
-    return;
+    return false;
   }
 
   bool nl = false;
 
   while ((p = fgets(buf, sizeof(buf), f))) {
     if (!nl) {
-      if (!utils_startswith(p, obj)) {
+      if (!utils_startswith(p, target)) {
         continue;
       }
       p += len;
+      if (*p == ' ') {
+        // Multiple targets, eg: `m.o gcm.cache/m.gcm: m.cpp` for C++ module interface
+        p = strchr(p, ':');
+        if (!p) {
+          continue;
+        }
+      }
       if (*p++ != ':') {
         continue;
       }
@@ -106,70 +123,901 @@ static void _cc_deps_MMD_add(struct node *n, struct deps *deps, const char *src,
           *p = '\0';
           ++p;
         }
-        _cc_deps_MMD_item_add(sp, n, deps, src);
+        visitor(sp, d);
       }
     }
   }
   fclose(f);
+  return true;
 }
 
-struct _cc_task {
-  struct spawn *s;
+static void _cc_deps_MMD_add(struct node *n, struct deps *deps, const char *src, const char *obj) {
+  char buf[PATH_MAX];
+  utils_strncpy(buf, obj, sizeof(buf));
+
+  char *p = strrchr(buf, '.');
+  akassert(p && p[1] != '\0');
+  p[1] = 'd';
+  p[2] = '\0';
+
+  struct _cc_deps_MMD_ctx ctx = { .deps = deps, .src = src };
+  if (!_cc_deps_MMD_visit(buf, obj, &ctx, _cc_deps_MMD_item_add)) {
+    node_warn(n, "Failed to open compiler generated (-MMD) dependency file: %s", buf);
+  }
+}
+
+static void _cc_cflags_add(struct _cc_ctx *ctx, struct spawn *s) {
+  if (ctx->n_cflags) {
+    struct xstr *xstr = 0;
+    const char *cflags = node_value(ctx->n_cflags);
+    if (!is_vlist(cflags)) {
+      xstr = xstr_create_empty();
+      utils_split_values_add(cflags, xstr);
+      cflags = xstr_ptr(xstr);
+    }
+    spawn_arg_add(s, cflags);
+    xstr_destroy(xstr);
+  }
+}
+
+static bool _cc_is_clang(struct _cc_ctx *ctx) {
+  char buf[PATH_MAX];
+  utils_strncpy(buf, ctx->cc, sizeof(buf));
+  return strstr(path_basename(buf), "clang") != 0;
+}
+
+struct _cc_pch_check_ctx {
+  uint64_t mtime;
+  bool     outdated;
+};
+
+static void _cc_pch_check_item(const char *item, void *d) {
+  struct _cc_pch_check_ctx *ctx = d;
+  if (!ctx->outdated) {
+    uint64_t mtime = path_mtime(item);
+    ctx->outdated = mtime == 0 || mtime > ctx->mtime;
+  }
+}
+
+static void _cc_pch_dep_item(const char *item, void *d) {
+  deps_add(d, DEPS_TYPE_FILE, 0, item, 0);
+}
+
+// Builds precompiled header shared by all rules with the same compiler, flags and header.
+// Compiler generated dependencies of the header are added to the rule dependencies,
+// so any change of them triggers rebuild of precompiled header and then all rule sources.
+static void _cc_pch_prepare(struct node *n, struct deps *deps, struct pool *pool) {
+  struct _cc_ctx *ctx = n->impl;
+  struct unit *unit = unit_peek();
+  if (!ctx->pch_header) {
+    return;
+  }
+  bool clang = _cc_is_clang(ctx);
+  const char *cflags = ctx->n_cflags ? node_value(ctx->n_cflags) : 0;
+
+  struct xstr *xstr = xstr_create_empty();
+  xstr_printf(xstr, "%s\1%u\1%s\1%s", ctx->cc, n->kw, cflags ? cflags : "", ctx->pch_header);
+  uint64_t hash = utils_hash64(xstr_ptr(xstr), xstr_size(xstr));
+  xstr_destroy(xstr);
+
+  char buf[PATH_MAX];
+  utils_strncpy(buf, ctx->pch_header, sizeof(buf));
+  const char *dir = pool_printf(pool, "%s/.pch-%016" PRIx64, unit->cache_dir, hash);
+  const char *stub = pool_printf(pool, "%s/%s", dir, path_basename(buf));
+  const char *dfile = pool_printf(pool, "%s.d", stub);
+  ctx->pch_stub = pool_strdup(ctx->pool, stub);
+  ctx->pch = pool_printf(ctx->pool, "%s.%s", stub, clang ? "pch" : "gch");
+
+  struct _cc_pch_check_ctx cctx = { .mtime = path_mtime(ctx->pch) };
+  if (cctx.mtime) {
+    if (!_cc_deps_MMD_visit(dfile, ctx->pch, &cctx, _cc_pch_check_item)) {
+      cctx.outdated = true;
+    }
+  } else {
+    cctx.outdated = true;
+  }
+
+  if (cctx.outdated) {
+    if (g_env.check.log) {
+      xstr_printf(g_env.check.log, "%s: pch build %s\n", n->name, path_basename(buf));
+    }
+    int rc = path_mkdirs(dir);
+    if (rc) {
+      node_fatal(rc, n, "Failed to create directory: %s", dir);
+    }
+    const char *content = pool_printf(pool, "#include \"%s\"\n", ctx->pch_header);
+    rc = utils_file_write_buf(stub, content, strlen(content), false);
+    if (rc) {
+      node_fatal(rc, n, "Failed to write file: %s", stub);
+    }
+
+    struct spawn *s = spawn_create(ctx->cc, ctx);
+    _cc_cflags_add(ctx, s);
+    if (!spawn_arg_starts_with(s, "-M")) {
+      spawn_arg_add(s, "-MMD");
+      spawn_arg_add(s, "-MF");
+      spawn_arg_add(s, dfile);
+    }
+    spawn_arg_add(s, "-I./"); // Current cache dir
+    spawn_arg_add(s, "-x");
+    spawn_arg_add(s, n->kw == NODE_KW_CC ? "c-header" : "c++-header");
+    spawn_arg_add(s, stub);
+    spawn_arg_add(s, "-o");
+    spawn_arg_add(s, ctx->pch);
+
+    rc = spawn_do(s);
+    if (rc) {
+      node_fatal(rc, n, "%s", ctx->cc);
+    } else {
+      int code = spawn_exit_code(s);
+      if (code != 0) {
+        node_fatal(AK_ERROR_EXTERNAL_COMMAND, n, "Failed to build precompiled header %s: %d",
+                   ctx->pch_header, code);
+      }
+    }
+    spawn_destroy(s);
+  }
+
+  deps_add(deps, DEPS_TYPE_FILE, 0, ctx->pch_header, 0);
+  _cc_deps_MMD_visit(dfile, ctx->pch, deps, _cc_pch_dep_item);
+}
+
+#define _CC_MOD_PENDING  0
+#define _CC_MOD_BUILDING 1
+#define _CC_MOD_DONE     2
+#define _CC_MOD_FAILED   3
+
+/// C++20 module dependencies of source scanned in P1689 format.
+struct _cc_module {
+  const char  *provides;  // Name of module provided by source or zero
+  const char **requires;  // Names of imported modules
+  int nrequires;
+  int state;              // Build state of provided module: _CC_MOD_*
+};
+
+struct _cc_task_item {
   char *src;
   char *obj;
+  struct _cc_module *mod;
+  int64_t cost;  // Estimated compile time
+  int     seq;   // Position in the list of sources
+  bool    hot;   // Source changed itself or failed in the previous build
+};
+
+struct _cc_task {
+  struct spawn *s;
+  struct xstr  *out;  // Buffered stdout/stderr of task processes
+  struct ulist items; // struct _cc_task_item
+  int64_t ts;         // Start time
   pid_t pid;
+  bool  preprocess;   // Source is preprocessed locally before passing it to executor
 };
 
-static void _cc_task_destroy(struct _cc_task *t) {
+static void _cc_task_destroy(struct _cc_ctx *ctx, struct _cc_task *t) {
+  map_remove_u64(ctx->outputs, (uintptr_t) t->s);
   spawn_destroy(t->s);
-  free(t->src);
-  free(t->obj);
+  xstr_destroy(t->out);
+  for (int i = 0; i < t->items.num; ++i) {
+    struct _cc_task_item *item = ulist_get(&t->items, i);
+    free(item->src);
+    free(item->obj);
+  }
+  ulist_destroy_keep(&t->items);
+}
+
+// Computes source path and object path relative to the unit cache dir.
+static void _cc_task_item_init(struct unit *unit, const char *path, struct _cc_task_item *item) {
+  char buf[PATH_MAX];
+  char *obj, *src = path_normalize_cwd(path, unit->cache_dir, buf);
+  bool incache = path_is_prefix_for(g_env.project.cache_dir, src, unit->cache_dir);
+  if (!incache) {
+    obj = path_relativize_cwd(unit->dir, src, unit->dir);
+    src = path_relativize_cwd(unit->cache_dir, src, unit->cache_dir);
+  } else {
+    obj = path_relativize_cwd(unit->cache_dir, src, unit->cache_dir);
+    src = xstrdup(obj);
+  }
+  char *p = strrchr(obj, '.');
+  akassert(p && p[1] != '\0');
+  p[1] = 'o';
+  p[2] = '\0';
+  item->src = src;
+  item->obj = obj;
+}
+
+// Compiler invoked with several sources writes objects and -MMD files into the current dir,
+// so only sources with objects located in the unit cache dir itself can be batched.
+static bool _cc_task_item_is_batchable(const struct _cc_task_item *item) {
+  return strchr(item->obj, '/') == 0;
+}
+
+// Returns number of sources passed to a single compiler invocation.
+static int _cc_batch_size(struct _cc_ctx *ctx) {
+  if (ctx->batch < 2 || _cdb.path || ctx->modules || ctx->remote) {
+    // Compilation database requires an entry per source,
+    // modules are compiled individually in the order of their dependencies,
+    // executor compiles a single preprocessed source per job.
+    return 1;
+  }
+  struct spawn *s = spawn_create(ctx->cc, ctx);
+  _cc_cflags_add(ctx, s);
+  bool ok = !(  spawn_arg_starts_with(s, "-o") || spawn_arg_starts_with(s, "-MF")
+             || spawn_arg_starts_with(s, "-MT") || spawn_arg_starts_with(s, "-MQ"));
+  spawn_destroy(s);
+  if (!ok) {
+    node_warn(ctx->n, "Batched compilation is disabled since compiler flags define output files");
+    return 1;
+  }
+  return ctx->batch;
+}
+
+// Path of built module interface (BMI) relative to the unit cache dir.
+// GCC uses `gcm.cache` dir of its default module mapper, clang reads modules from `-fprebuilt-module-path`.
+static const char* _cc_module_bmi(struct _cc_ctx *ctx, const char *name, char buf[PATH_MAX]) {
+  snprintf(buf, PATH_MAX, _cc_is_clang(ctx) ? "pcm.cache/%s.pcm" : "gcm.cache/%s.gcm", name);
+  for (char *c = strchr(buf, '/') + 1; *c; ++c) {
+    if (*c == ':') { // Module partition
+      *c = '-';
+    }
+  }
+  return buf;
+}
+
+// Reads JSON string at `p`, returns position after the closing quote.
+static const char* _cc_p1689_string(const char *p, struct xstr *xstr) {
+  xstr_clear(xstr);
+  for (++p; *p && *p != '"'; ++p) {
+    if (*p == '\\' && p[1]) {
+      ++p;
+    }
+    xstr_cat2(xstr, p, 1);
+  }
+  return *p ? p + 1 : p;
+}
+
+// Visits `logical-name` values of `provides` and `requires` arrays of P1689 dependency file.
+static void _cc_p1689_visit(
+  const char *json,
+  void       *d,
+  void (     *visitor)(char kind, const char *name, void *d)) {
+  struct xstr *xstr = xstr_create_empty();
+  int depth = 0, kdepth = 0;
+  char kind = 0;
+
+  for (const char *p = json; *p; ) {
+    if (*p == '"') {
+      p = _cc_p1689_string(p, xstr);
+      while (utils_char_is_space(*p)) {
+        ++p;
+      }
+      if (*p != ':') {
+        continue;
+      }
+      for (++p; utils_char_is_space(*p); ++p);
+      const char *key = xstr_ptr(xstr);
+      if (strcmp(key, "provides") == 0) {
+        kind = 'p';
+        kdepth = depth;
+      } else if (strcmp(key, "requires") == 0) {
+        kind = 'r';
+        kdepth = depth;
+      } else if (kind && *p == '"' && strcmp(key, "logical-name") == 0) {
+        p = _cc_p1689_string(p, xstr);
+        visitor(kind, xstr_ptr(xstr), d);
+      }
+      continue;
+    }
+    if (*p == '{' || *p == '[') {
+      ++depth;
+    } else if (*p == '}' || *p == ']') {
+      if (--depth == kdepth) {
+        kind = 0;
+      }
+    }
+    ++p;
+  }
+  xstr_destroy(xstr);
+}
+
+struct _cc_module_scan_ctx {
+  struct pool *pool;
+  struct _cc_module *mod;
+  struct ulist requires; // const char*
+};
+
+static void _cc_module_scan_item(char kind, const char *name, void *d) {
+  struct _cc_module_scan_ctx *ctx = d;
+  if (kind == 'p') {
+    if (!ctx->mod->provides) {
+      ctx->mod->provides = pool_strdup(ctx->pool, name);
+    }
+  } else {
+    const char *v = pool_strdup(ctx->pool, name);
+    ulist_push(&ctx->requires, &v);
+  }
+}
+
+static void _cc_module_scan_stdout_handler(char *buf, size_t buflen, struct spawn *s) {
+  xstr_cat2(spawn_user_data(s), buf, buflen);
+}
+
+// Runs P1689 dependency scanner for the given source, scan results are saved into `<obj>.ddi` file.
+// clang and custom scanners are called in `clang-scan-deps` style and print results to stdout:
+//   SCANNER -format=p1689 -- COMPILER FLAGS -c SOURCE -o OBJECT
+static void _cc_module_scan_run(struct _cc_ctx *ctx, const struct _cc_task_item *item, const char *ddi) {
+  struct xstr *xstr = xstr_create_empty();
+  struct spawn *s;
+  bool gcc = !ctx->scanner && !_cc_is_clang(ctx);
+  if (gcc) {
+    s = spawn_create(ctx->cc, ctx);
+    _cc_cflags_add(ctx, s);
+    if (!spawn_arg_starts_with(s, "-fmodules")) {
+      spawn_arg_add(s, "-fmodules-ts");
+    }
+    spawn_arg_add(s, "-I./"); // Current cache dir
+    spawn_arg_add(s, "-E");
+    spawn_arg_add(s, "-x");
+    spawn_arg_add(s, "c++");
+    spawn_arg_add(s, item->src);
+    char buf[PATH_MAX + 32];
+    spawn_arg_add(s, "-fdeps-format=p1689r5");
+    snprintf(buf, sizeof(buf), "-fdeps-file=%s", ddi);
+    spawn_arg_add(s, buf);
+    snprintf(buf, sizeof(buf), "-fdeps-target=%s", item->obj);
+    spawn_arg_add(s, buf);
+    spawn_arg_add(s, "-MD");
+    spawn_arg_add(s, "-MF");
+    spawn_arg_add(s, "/dev/null");
+    spawn_arg_add(s, "-o");
+    spawn_arg_add(s, "/dev/null");
+  } else {
+    s = spawn_create(ctx->scanner ? ctx->scanner : "clang-scan-deps", xstr);
+    spawn_set_stdout_handler(s, _cc_module_scan_stdout_handler);
+    spawn_arg_add(s, "-format=p1689");
+    spawn_arg_add(s, "--");
+    spawn_arg_add(s, ctx->cc);
+    _cc_cflags_add(ctx, s);
+    spawn_arg_add(s, "-I./"); // Current cache dir
+    spawn_arg_add(s, "-c");
+    spawn_arg_add(s, item->src);
+    spawn_arg_add(s, "-o");
+    spawn_arg_add(s, item->obj);
+  }
+
+  unlink(ddi);
+  int rc = spawn_do(s);
+  if (!rc && spawn_exit_code(s) != 0) {
+    rc = AK_ERROR_EXTERNAL_COMMAND;
+  }
+  if (rc) {
+    node_warn(ctx->n, "Failed to scan module dependencies of: %s", item->src);
+  } else if (!gcc) {
+    rc = utils_file_write_buf(ddi, xstr_ptr(xstr), xstr_size(xstr), false);
+    if (rc) {
+      node_fatal(rc, ctx->n, "Failed to write file: %s", ddi);
+    }
+  }
+  spawn_destroy(s);
+  xstr_destroy(xstr);
+}
+
+// Returns module dependencies of the source. Scan results are cached in `<obj>.ddi` file,
+// source is rescanned if it is going to be compiled or it is newer than the cached results.
+static struct _cc_module* _cc_module_scan(
+  struct _cc_ctx             *ctx,
+  const struct _cc_task_item *item,
+  bool                        rescan,
+  struct pool                *pool) {
+  const char *ddi = pool_printf(pool, "%s.ddi", item->obj);
+  uint64_t mtime = path_mtime(ddi);
+  if (rescan || mtime == 0 || mtime < path_mtime(item->src)) {
+    _cc_module_scan_run(ctx, item, ddi);
+  }
+
+  struct _cc_module *mod = pool_calloc(pool, sizeof(*mod));
+  struct _cc_module_scan_ctx sctx = {
+    .pool = pool,
+    .mod = mod,
+    .requires = { .usize = sizeof(char*) }
+  };
+  struct value val = utils_file_as_buf(ddi, 16 * 1024 * 1024);
+  if (!val.error) {
+    _cc_p1689_visit(val.buf, &sctx, _cc_module_scan_item);
+  }
+  value_destroy(&val);
+
+  if (sctx.requires.num) {
+    mod->nrequires = sctx.requires.num;
+    mod->requires = pool_alloc(pool, sctx.requires.num * sizeof(char*));
+    for (int i = 0; i < sctx.requires.num; ++i) {
+      mod->requires[i] = *(const char**) ulist_get(&sctx.requires, i);
+    }
+  }
+  ulist_destroy_keep(&sctx.requires);
+  return mod;
+}
+
+// Scans module dependencies of all rule sources and queues sources importing modules
+// provided by queued sources, since they must be recompiled with updated module interfaces.
+// Returns map of module names to provider modules, `srcs` is filled by modules of all sources.
+static struct map* _cc_modules_prepare(
+  struct _cc_ctx *ctx,
+  struct ulist   *queue,
+  struct map     *srcs,
+  struct pool    *pool) {
+  struct unit *unit = unit_peek();
+  struct map *queued = map_create_str(map_k_free);
+  struct map *names = map_create_str(map_k_free);
+  struct ulist all = { .usize = sizeof(struct _cc_task_item) };
+
+  for (int i = 0; i < queue->num; ++i) {
+    struct _cc_task_item *item = ulist_get(queue, i);
+    map_put_str(queued, item->src, (void*) (intptr_t) (i + 1));
+  }
+  for (int i = 0; i < ctx->sources.num; ++i) {
+    struct _cc_task_item item = { 0 };
+    _cc_task_item_init(unit, *(char**) ulist_get(&ctx->sources, i), &item);
+    intptr_t qidx = (intptr_t) map_get(queued, item.src);
+    struct _cc_task_item *qitem = qidx ? ulist_get(queue, qidx - 1) : 0;
+    item.mod = _cc_module_scan(ctx, &item, qitem != 0, pool);
+    map_put_str(srcs, item.src, item.mod);
+    if (qitem) {
+      qitem->mod = item.mod;
+    }
+    if (item.mod->provides) {
+      struct _cc_module *pmod = map_get(names, item.mod->provides);
+      if (pmod) {
+        node_fatal(AK_ERROR_FAIL, ctx->n, "Module '%s' is provided by multiple sources", item.mod->provides);
+      }
+      map_put_str(names, item.mod->provides, item.mod);
+      char buf[PATH_MAX];
+      const char *bmi = _cc_module_bmi(ctx, item.mod->provides, buf);
+      node_product_add(ctx->n, bmi, 0);
+      if (!qitem && !path_is_exist(bmi)) {
+        // Module interface is lost
+        map_put_str(queued, item.src, (void*) (intptr_t) 1);
+        ulist_push(queue, &item);
+        item.src = 0;
+        item.obj = 0;
+      } else if (!qitem) {
+        item.mod->state = _CC_MOD_DONE;
+      }
+    }
+    ulist_push(&all, &item);
+  }
+
+  // Transitive closure of dependents of rebuilt modules
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = 0; i < all.num; ++i) {
+      struct _cc_task_item *item = ulist_get(&all, i);
+      if (!item->src || map_get(queued, item->src)) {
+        continue;
+      }
+      for (int j = 0; j < item->mod->nrequires; ++j) {
+        struct _cc_module *pmod = map_get(names, item->mod->requires[j]);
+        if (pmod && pmod->state == _CC_MOD_PENDING) {
+          if (item->mod->provides) {
+            item->mod->state = _CC_MOD_PENDING;
+          }
+          map_put_str(queued, item->src, (void*) (intptr_t) 1);
+          ulist_push(queue, item);
+          item->src = 0;
+          item->obj = 0;
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < all.num; ++i) {
+    struct _cc_task_item *item = ulist_get(&all, i);
+    free(item->src);
+    free(item->obj);
+  }
+  ulist_destroy_keep(&all);
+  map_destroy(queued);
+  return names;
+}
+
+// Returns state of the queued source: _CC_MOD_PENDING if source is waiting for imported modules,
+// _CC_MOD_FAILED if any of imported modules failed, _CC_MOD_DONE if source is ready to compile.
+static int _cc_module_item_state(struct map *names, const struct _cc_task_item *item) {
+  if (!names || !item->mod) {
+    return _CC_MOD_DONE;
+  }
+  int ret = _CC_MOD_DONE;
+  for (int i = 0; i < item->mod->nrequires; ++i) {
+    struct _cc_module *pmod = map_get(names, item->mod->requires[i]);
+    if (!pmod || pmod == item->mod) {
+      continue; // Module provided outside of this rule
+    }
+    if (pmod->state == _CC_MOD_FAILED) {
+      return _CC_MOD_FAILED;
+    } else if (pmod->state != _CC_MOD_DONE) {
+      ret = _CC_MOD_PENDING;
+    }
+  }
+  return ret;
+}
+
+// Adds module interfaces imported by successfully compiled source to its dependencies,
+// so changed interface triggers recompilation of the source.
+static void _cc_module_deps_add(
+  struct _cc_ctx             *ctx,
+  struct map                 *names,
+  struct deps                *deps,
+  const struct _cc_task_item *item) {
+  if (!names || !item->mod) {
+    return;
+  }
+  for (int i = 0; i < item->mod->nrequires; ++i) {
+    struct _cc_module *pmod = map_get(names, item->mod->requires[i]);
+    if (pmod && pmod != item->mod) {
+      char buf[PATH_MAX];
+      deps_add_alias(deps, 's', item->src, _cc_module_bmi(ctx, pmod->provides, buf));
+    }
+  }
+}
+
+// Loads compile times (ms) of sources recorded by previous builds.
+static struct map* _cc_times_load(const char *path) {
+  char buf[PATH_MAX + 32];
+  struct map *times = map_create_str(map_k_free);
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return times;
+  }
+  while (fgets(buf, sizeof(buf), f)) {
+    int rc = 0;
+    buf[strcspn(buf, "\n")] = '\0';
+    char *p = strchr(buf, ' ');
+    if (!p) {
+      continue;
+    }
+    *p++ = '\0';
+    int64_t ms = utils_strtoll(buf, 10, &rc);
+    if (!rc && ms >= 0) {
+      map_put_str(times, p, (void*) (intptr_t) (ms + 1));
+    }
+  }
+  fclose(f);
+  return times;
+}
+
+static void _cc_times_save(struct _cc_ctx *ctx, const char *path, struct map *times) {
+  struct unit *unit = unit_peek();
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    node_warn(ctx->n, "Failed to open file for writing: %s", path);
+    return;
+  }
+  for (int i = 0; i < ctx->sources.num; ++i) {
+    struct _cc_task_item item = { 0 };
+    _cc_task_item_init(unit, *(char**) ulist_get(&ctx->sources, i), &item);
+    intptr_t v = (intptr_t) map_get(times, item.src);
+    if (v) {
+      fprintf(f, "%" PRId64 " %s\n", (int64_t) v - 1, item.src);
+    }
+    free(item.src);
+    free(item.obj);
+  }
+  fclose(f);
+}
+
+static int _cc_queue_cmp(const void *a_, const void *b_) {
+  const struct _cc_task_item *a = a_, *b = b_;
+  if (a->hot != b->hot) {
+    return a->hot ? -1 : 1;
+  }
+  if (a->cost != b->cost) {
+    return a->cost > b->cost ? -1 : 1;
+  }
+  return a->seq - b->seq;
+}
+
+static int64_t _cc_source_size(const char *src) {
+  struct akpath_stat st;
+  return path_stat(src, &st) ? 0 : (int64_t) st.size;
+}
+
+// Orders queued sources by estimated compile time, longest first, to avoid a long single job
+// at the end of build. Estimation is based on recorded compile times of sources,
+// sources without history are estimated by file size using the average compile speed.
+// Hot sources, edited since the last build or failed in it, go ahead of the rest
+// since they are the most likely to fail and should report errors early.
+static void _cc_queue_sort(struct ulist *queue, struct map *times, struct map *hot) {
+  int64_t total_ms = 0, total_size = 0;
+  for (int i = 0; i < queue->num; ++i) {
+    struct _cc_task_item *item = ulist_get(queue, i);
+    intptr_t v = (intptr_t) map_get(times, item->src);
+    item->seq = i;
+    item->hot = map_get(hot, item->src) != 0;
+    if (v) {
+      total_ms += v - 1;
+      total_size += _cc_source_size(item->src);
+    }
+  }
+  for (int i = 0; i < queue->num; ++i) {
+    struct _cc_task_item *item = ulist_get(queue, i);
+    intptr_t v = (intptr_t) map_get(times, item->src);
+    if (v) {
+      item->cost = v - 1;
+    } else if (total_ms == 0) {
+      item->cost = _cc_source_size(item->src);
+    } else if (total_size) {
+      item->cost = _cc_source_size(item->src) * total_ms / total_size;
+    } else {
+      item->cost = 0;
+    }
+  }
+  if (queue->num > 1) {
+    qsort(ulist_get(queue, 0), queue->num, queue->usize, _cc_queue_cmp);
+  }
+}
+
+// Path of locally preprocessed source passed to executor.
+static const char* _cc_preprocessed_path(const char *obj, char buf[PATH_MAX]) {
+  utils_strncpy(buf, obj, PATH_MAX);
+  char *p = strrchr(buf, '.');
+  akassert(p && p[1] != '\0');
+  p[1] = 'i';
+  p[2] = '\0';
+  return buf;
+}
+
+struct _cc_preprocess_ctx {
+  struct spawn *s;
+  const char   *ipath;
+  bool output;
+};
+
+static void _cc_preprocess_arg_add(int num, const char *arg, void *d) {
+  struct _cc_preprocess_ctx *ctx = d;
+  if (num == 0) {
+    return;
+  }
+  if (ctx->output) {
+    ctx->output = false;
+    spawn_arg_add(ctx->s, ctx->ipath);
+  } else if (strcmp(arg, "-c") == 0) {
+    spawn_arg_add(ctx->s, "-E");
+  } else {
+    ctx->output = strcmp(arg, "-o") == 0;
+    spawn_arg_add(ctx->s, arg);
+  }
+}
+
+static void _cc_output_handler(char *buf, size_t buflen, struct spawn *s) {
+  struct _cc_ctx *ctx = spawn_user_data(s);
+  struct xstr *out = map_get_u64(ctx->outputs, (uintptr_t) s);
+  if (out) {
+    xstr_cat2(out, buf, buflen);
+  }
+}
+
+static void _cc_on_spawn_exit(struct spawn *s) {
+  struct _cc_ctx *ctx = spawn_user_data(s);
+  ulist_push(&ctx->finished, &s);
+}
+
+// Starts compile task process, finished processes are collected in `ctx->finished` by spawn_poll().
+// Process output is buffered in `out` and printed by _cc_task_report() when the task is finished.
+static int _cc_spawn_start(struct _cc_ctx *ctx, struct spawn *s, struct xstr *out) {
+  spawn_set_stdout_handler(s, _cc_output_handler);
+  spawn_set_stderr_handler(s, _cc_output_handler);
+  spawn_set_exit_handler(s, _cc_on_spawn_exit);
+  spawn_set_silent(s, true);
+  map_put_u64(ctx->outputs, (uintptr_t) s, out);
+  int rc = spawn_start(s);
+  if (rc) {
+    map_remove_u64(ctx->outputs, (uintptr_t) s);
+  }
+  return rc;
+}
+
+static void _cc_cmd_arg_add(int num, const char *arg, void *d) {
+  struct xstr *xstr = d;
+  if (num) {
+    xstr_cat2(xstr, " ", 1);
+  }
+  xstr_cat(xstr, arg);
+}
+
+// Prints status line of finished task: `[done/total] cc <sources>` followed by buffered output
+// of compiler as a single block. Full command line is printed in verbose mode or if task is failed.
+static void _cc_task_report(struct _cc_ctx *ctx, struct _cc_task *t, int code, int done, int total) {
+  struct unit *unit = unit_peek();
+  struct xstr *xstr = xstr_create_empty();
+  xstr_printf(xstr, "[%d/%d] %s", done, total, ctx->n->value);
+  for (int i = 0; i < t->items.num; ++i) {
+    char buf[PATH_MAX];
+    struct _cc_task_item *item = ulist_get(&t->items, i);
+    char *path = path_relativize_cwd(g_env.project.root_dir,
+                                     path_normalize_cwd(item->src, unit->cache_dir, buf),
+                                     g_env.project.root_dir);
+    xstr_printf(xstr, " %s", path);
+    free(path);
+  }
+  xstr_cat2(xstr, "\n", 1);
+  if ((g_env.verbose || code != 0) && t->s) {
+    spawn_visit_cmd(t->s, xstr, _cc_cmd_arg_add);
+    xstr_cat2(xstr, "\n", 1);
+  }
+  fwrite(xstr_ptr(xstr), 1, xstr_size(xstr), stdout);
+  fflush(stdout);
+  if (xstr_size(t->out)) {
+    fwrite(xstr_ptr(t->out), 1, xstr_size(t->out), stderr);
+    fflush(stderr);
+  }
+  xstr_destroy(xstr);
+}
+
+// Turns compile command into the command preprocessing source locally,
+// dependency file is generated for the object as usual.
+static struct spawn* _cc_preprocess_spawn(struct _cc_ctx *ctx, struct spawn *s, struct _cc_task_item *item) {
+  char buf[PATH_MAX];
+  struct spawn *pp = spawn_create(ctx->cc, ctx);
+  struct _cc_preprocess_ctx pctx = { .s = pp, .ipath = _cc_preprocessed_path(item->obj, buf) };
+  spawn_visit_cmd(s, &pctx, _cc_preprocess_arg_add);
+  if (!spawn_arg_starts_with(pp, "-MT") && !spawn_arg_starts_with(pp, "-MQ")) {
+    spawn_arg_add(pp, "-MT");
+    spawn_arg_add(pp, item->obj);
+  }
+  return pp;
+}
+
+// Passes preprocessed source to executor: `<executor> <cc> [cflags] -x <lang> -c`.
+// Executor reads preprocessed source from stdin and writes object file to stdout.
+static bool _cc_on_compile_remote(struct node *n, struct _cc_task *task) {
+  struct _cc_ctx *ctx = n->impl;
+  struct _cc_task_item *item = ulist_get(&task->items, 0);
+  if (g_env.check.log) {
+    xstr_printf(g_env.check.log, "%s: remote src=%s obj=%s\n", n->name, item->src, item->obj);
+  }
+
+  const char *cmd = g_env.executor.cmd;
+  while (utils_char_is_space(*cmd)) {
+    ++cmd;
+  }
+  size_t len = 0;
+  while (cmd[len] != '\0' && !utils_char_is_space(cmd[len])) {
+    ++len;
+  }
+  char *exec = strndup(cmd, len);
+  struct spawn *s = spawn_create(exec, ctx);
+  free(exec);
+  if (cmd[len] != '\0') {
+    struct xstr *xstr = xstr_create_empty();
+    utils_split_values_add(cmd + len, xstr);
+    spawn_arg_add(s, xstr_ptr(xstr));
+    xstr_destroy(xstr);
+  }
+
+  char buf[PATH_MAX];
+  spawn_arg_add(s, ctx->cc);
+  _cc_cflags_add(ctx, s);
+  spawn_arg_add(s, "-x");
+  spawn_arg_add(s, utils_endswith(item->src, ".c") ? "cpp-output" : "c++-cpp-output");
+  spawn_arg_add(s, "-c");
+  spawn_set_stdin_file(s, _cc_preprocessed_path(item->obj, buf));
+  spawn_set_stdout_file(s, item->obj);
+
+  map_remove_u64(ctx->outputs, (uintptr_t) task->s);
+  spawn_destroy(task->s);
+  task->s = s;
+  task->preprocess = false;
+
+  int rc = _cc_spawn_start(ctx, s, task->out);
+  if (rc) {
+    spawn_destroy(s);
+    task->s = 0;
+    node_error(rc, n, "%s", g_env.executor.cmd);
+    return false;
+  }
+  task->pid = spawn_pid(s);
+  return true;
+}
+
+// Returns number of tasks preprocessing sources locally.
+static int _cc_tasks_preprocessing(struct ulist *tasks) {
+  int ret = 0;
+  for (int i = 0; i < tasks->num; ++i) {
+    struct _cc_task *t = ulist_get(tasks, i);
+    if (t->preprocess) {
+      ++ret;
+    }
+  }
+  return ret;
 }
 
 static void _cc_on_build_source(
   struct node     *n,
   struct deps     *deps,
-  const char      *src,
-  const char      *obj,
   struct _cc_task *task) {
   if (g_env.check.log) {
-    xstr_printf(g_env.check.log, "%s: build src=%s obj=%s\n", n->name, src, obj);
+    for (int i = 0; i < task->items.num; ++i) {
+      struct _cc_task_item *item = ulist_get(&task->items, i);
+      xstr_printf(g_env.check.log, "%s: build src=%s obj=%s\n", n->name, item->src, item->obj);
+    }
+    if (task->items.num > 1) {
+      xstr_printf(g_env.check.log, "%s: batch num=%d\n", n->name, task->items.num);
+    }
   }
 
   struct _cc_ctx *ctx = n->impl;
   struct spawn *s = spawn_create(ctx->cc, ctx);
   task->s = s;
 
-  spawn_set_nowait(s, true);
+  _cc_cflags_add(ctx, s);
 
-  if (ctx->n_cflags) {
-    struct xstr *xstr = 0;
-    const char *cflags = node_value(ctx->n_cflags);
-    if (!is_vlist(cflags)) {
-      xstr = xstr_create_empty();
-      utils_split_values_add(cflags, xstr);
-      cflags = xstr_ptr(xstr);
+  if (ctx->pch && ctx->remote) {
+    // Precompiled header is not usable for preprocessing
+    spawn_arg_add(s, "-include");
+    spawn_arg_add(s, ctx->pch_header);
+  } else if (ctx->pch) {
+    if (_cc_is_clang(ctx)) {
+      spawn_arg_add(s, "-include-pch");
+      spawn_arg_add(s, ctx->pch);
+    } else {
+      // GCC picks up `.gch` file located next to the included stub
+      spawn_arg_add(s, "-include");
+      spawn_arg_add(s, ctx->pch_stub);
     }
-    spawn_arg_add(s, cflags);
-    xstr_destroy(xstr);
   }
 
   if (!spawn_arg_starts_with(s, "-M")) {
     spawn_arg_add(s, "-MMD");
   }
 
+  struct _cc_task_item *item = ulist_get(&task->items, 0);
+  if (ctx->modules) {
+    if (_cc_is_clang(ctx)) {
+      spawn_arg_add(s, "-fprebuilt-module-path=pcm.cache");
+      if (item->mod && item->mod->provides) {
+        char buf[PATH_MAX], arg[PATH_MAX + 32];
+        snprintf(arg, sizeof(arg), "-fmodule-output=%s", _cc_module_bmi(ctx, item->mod->provides, buf));
+        spawn_arg_add(s, arg);
+        if (!utils_endswith(item->src, ".cppm")) {
+          spawn_arg_add(s, "-x");
+          spawn_arg_add(s, "c++-module");
+        }
+      }
+    } else if (!spawn_arg_starts_with(s, "-fmodules")) {
+      spawn_arg_add(s, "-fmodules-ts");
+    }
+  }
+
   spawn_arg_add(s, "-I./"); // Current cache dir
   spawn_arg_add(s, "-c");
-  spawn_arg_add(s, src);
-
-  spawn_arg_add(s, "-o");
-  spawn_arg_add(s, obj);
+  for (int i = 0; i < task->items.num; ++i) {
+    struct _cc_task_item *item = ulist_get(&task->items, i);
+    spawn_arg_add(s, item->src);
+  }
 
-  _cc_cdb_entry_add(n, s, src, obj);
+  if (task->items.num == 1) {
+    spawn_arg_add(s, "-o");
+    spawn_arg_add(s, item->obj);
+    _cc_cdb_entry_add(n, s, item->src, item->obj);
+    if (ctx->remote) {
+      task->s = _cc_preprocess_spawn(ctx, s, item);
+      task->preprocess = true;
+      spawn_destroy(s);
+      s = task->s;
+    }
+  } else {
+    // Stale objects must not hide sources failed in batch
+    for (int i = 0; i < task->items.num; ++i) {
+      item = ulist_get(&task->items, i);
+      unlink(item->obj);
+    }
+  }
 
-  int rc = spawn_do(s);
+  int rc = _cc_spawn_start(ctx, s, task->out);
   if (rc) {
     spawn_destroy(s);
+    task->s = 0;
     node_error(rc, ctx->n, "%s", ctx->cc);
     return;
   }
@@ -185,13 +1033,28 @@ static void _cc_on_resolve(struct node_resolve *r) {
   struct ulist rlist = { .usize = sizeof(char*) };
   struct ulist tasks = { .usize = sizeof(struct _cc_task) };
   struct map *fmap = map_create_str(map_k_free);
+  struct map *hot = map_create_str(map_k_free);
 
   int max_jobs = g_env.max_parallel_jobs;
   if (max_jobs <= 0) {
     max_jobs = 1;
   }
+  // Built module interfaces are required locally, so modules are compiled locally
+  ctx->remote = g_env.executor.cmd && !ctx->modules;
+  int max_tasks = ctx->remote ? MAX(g_env.executor.jobs, max_jobs) : max_jobs;
 
   if (r->resolve_outdated.num) {
+    for (int i = 0; i < r->resolve_outdated.num; ++i) {
+      struct resolve_outdated *u = ulist_get(&r->resolve_outdated, i);
+      if (u->flags == 's' && (u->type == DEPS_TYPE_FILE || u->type == DEPS_TYPE_FILE_OUTDATED)) {
+        // Source itself is modified or failed last time
+        struct _cc_task_item item = { 0 };
+        _cc_task_item_init(unit, u->path, &item);
+        map_put_str(hot, item.src, (void*) (intptr_t) 1);
+        free(item.src);
+        free(item.obj);
+      }
+    }
     for (int i = 0; i < r->resolve_outdated.num; ++i) {
       struct resolve_outdated *u = ulist_get(&r->resolve_outdated, i);
       if (u->flags != 's') { // Rebuild all on any outdated non source dependency
@@ -204,13 +1067,30 @@ static void _cc_on_resolve(struct node_resolve *r) {
       }
     }
   }
+  if (slist == &rlist) {
+    // Sources without objects, eg: detached from unity files
+    for (int i = 0; i < ctx->sources.num; ++i) {
+      char *src = *(char**) ulist_get(&ctx->sources, i);
+      const char *obj = *(char**) ulist_get(&ctx->objects, i);
+      if (access(obj, F_OK) == 0) {
+        continue;
+      }
+      bool found = false;
+      for (int j = 0; j < rlist.num && !found; ++j) {
+        char buf[PATH_MAX];
+        const char *path = path_normalize_cwd(*(char**) ulist_get(&rlist, j), unit->cache_dir, buf);
+        found = strcmp(path, src) == 0;
+      }
+      if (!found) {
+        ulist_push(&rlist, &src);
+      }
+    }
+  }
 
   int rc = deps_open(r->deps_path_tmp, 0, &deps);
   if (rc) {
     node_fatal(rc, ctx->n, "Failed to open dependency file: %s", r->deps_path_tmp);
   }
-  node_add_unit_deps(ctx->n, &deps);
-
   for (int i = 0; i < r->node_val_deps.num; ++i) {
     struct node *nv = *(struct node**) ulist_get(&r->node_val_deps, i);
     const char *val = node_value(nv);
@@ -218,107 +1098,199 @@ static void _cc_on_resolve(struct node_resolve *r) {
       deps_add(&deps, DEPS_TYPE_NODE_VALUE, 0, val, i);
     }
   }
+  if (ctx->cc_env) {
+    const char *cc = node_env_get(ctx->n, ctx->cc_env);
+    deps_add_env(&deps, 0, ctx->cc_env, cc ? cc : "");
+  }
 
   for (int i = 0; i < ctx->consumes.num; ++i) {
     const char *path = *(const char**) ulist_get(&ctx->consumes, i);
     deps_add(&deps, DEPS_TYPE_FILE, 0, path, 0);
   }
 
-  for (int i = 0; i < slist->num || tasks.num > 0; ) {
-    while (tasks.num < max_jobs && i < slist->num) {
-      char buf[PATH_MAX];
-      char *obj, *src = *(char**) ulist_get(slist, i);
-      src = path_normalize_cwd(src, unit->cache_dir, buf);
-      bool incache = path_is_prefix_for(g_env.project.cache_dir, src, unit->cache_dir);
-      if (!incache) {
-        obj = path_relativize_cwd(unit->dir, src, unit->dir);
-        src = path_relativize_cwd(unit->cache_dir, src, unit->cache_dir);
-      } else {
-        obj = path_relativize_cwd(unit->cache_dir, src, unit->cache_dir);
-        src = xstrdup(obj);
+  _cc_pch_prepare(ctx->n, &deps, r->pool);
+
+  bool full = slist == &ctx->sources;
+
+  struct ulist queue = { .usize = sizeof(struct _cc_task_item) };
+  for (int i = 0; i < slist->num; ++i) {
+    struct _cc_task_item item = { 0 };
+    _cc_task_item_init(unit, *(char**) ulist_get(slist, i), &item);
+    ulist_push(&queue, &item);
+  }
+
+  struct map *msrcs = map_create_str(map_k_free);
+  struct map *modules = ctx->modules ? _cc_modules_prepare(ctx, &queue, msrcs, r->pool) : 0;
+  int batch = _cc_batch_size(ctx);
+
+  const char *times_path = pool_printf(r->pool, "%s/%s.times", unit->cache_dir, ctx->n->vfile);
+  struct map *times = _cc_times_load(times_path);
+  _cc_queue_sort(&queue, times, hot);
+  int done = 0, total = queue.num;
+
+  while (queue.num || tasks.num) {
+    while (tasks.num < max_tasks && queue.num && _cc_tasks_preprocessing(&tasks) < max_jobs) {
+      // Pick the first source which imported modules are ready
+      int q = 0, state = _CC_MOD_PENDING;
+      for ( ; q < queue.num; ++q) {
+        state = _cc_module_item_state(modules, ulist_get(&queue, q));
+        if (state != _CC_MOD_PENDING) {
+          break;
+        }
+      }
+      if (q == queue.num) {
+        break;
       }
 
-      char *p = strrchr(obj, '.');
-      akassert(p && p[1] != '\0');
-      p[1] = 'o';
-      p[2] = '\0';
+      struct _cc_task task = {
+        .items = { .usize = sizeof(struct _cc_task_item) },
+        .out = xstr_create_empty(),
+        .pid = -1
+      };
+      while (q < queue.num && task.items.num < batch) {
+        struct _cc_task_item *item = ulist_get(&queue, q);
+        bool batchable = _cc_task_item_is_batchable(item);
+        if (task.items.num && !batchable) {
+          break;
+        }
+        ulist_push(&task.items, item);
+        ulist_remove(&queue, q);
+        if (!batchable) {
+          break;
+        }
+      }
 
-      struct _cc_task task = { .src = src, .obj = obj, .pid = -1 };
-      _cc_on_build_source(ctx->n, &deps, src, obj, &task);
+      if (state == _CC_MOD_FAILED) {
+        struct _cc_task_item *item = ulist_get(&task.items, 0);
+        node_error(AK_ERROR_DEPENDENCY_UNRESOLVED, ctx->n,
+                   "Skipped, imported module failed to compile: %s", item->src);
+      } else {
+        _cc_on_build_source(ctx->n, &deps, &task);
+      }
 
+      task.ts = utils_current_time_ms();
       if (task.pid == -1) {
-        ++ctx->num_failed;
-        map_put_str(fmap, src, (void*) (intptr_t) 1);
-        if (slist == &ctx->sources) {
-          deps_add(&deps, DEPS_TYPE_FILE_OUTDATED, 's', src, 0);
+        done += task.items.num;
+        for (int j = 0; j < task.items.num; ++j) {
+          struct _cc_task_item *item = ulist_get(&task.items, j);
+          ++ctx->num_failed;
+          map_put_str(fmap, item->src, (void*) (intptr_t) 1);
+          if (item->mod && item->mod->provides) {
+            item->mod->state = _CC_MOD_FAILED;
+          }
+          if (full) {
+            deps_add(&deps, DEPS_TYPE_FILE_OUTDATED, 's', item->src, 0);
+          }
         }
-        _cc_task_destroy(&task);
+        _cc_task_destroy(ctx, &task);
       } else {
         ulist_push(&tasks, &task);
       }
-      ++i;
     }
 
-    int wstatus = 0;
-    pid_t pid = wait(&wstatus);
-    if (pid == -1) {
-      akfatal(errno, "wait() syscall failed", 0);
+    if (!tasks.num) {
+      if (queue.num) {
+        // Remaining sources are waiting for each other
+        for (int j = 0; j < queue.num; ++j) {
+          struct _cc_task_item *item = ulist_get(&queue, j);
+          node_error(AK_ERROR_CYCLIC_BUILD_DEPS, ctx->n, "Cyclic module imports: %s", item->src);
+          ++ctx->num_failed;
+          map_put_str(fmap, item->src, (void*) (intptr_t) 1);
+          if (full) {
+            deps_add(&deps, DEPS_TYPE_FILE_OUTDATED, 's', item->src, 0);
+          }
+          free(item->src);
+          free(item->obj);
+        }
+        ulist_clear(&queue);
+      }
+      continue;
     }
 
-    for (int j = 0; j < tasks.num; ++j) {
-      struct _cc_task *t = (struct _cc_task*) ulist_get(&tasks, j);
-      if (t->pid == pid) {
-        spawn_set_wstatus(t->s, wstatus);
+    spawn_poll();
+    for (int f = 0; f < ctx->finished.num; ++f) {
+      struct spawn *fs = *(struct spawn**) ulist_get(&ctx->finished, f);
+      for (int j = 0; j < tasks.num; ++j) {
+        struct _cc_task *t = (struct _cc_task*) ulist_get(&tasks, j);
+        if (t->s != fs) {
+          continue;
+        }
         int code = spawn_exit_code(t->s);
-        if (code != 0) {
-          ++ctx->num_failed;
-          map_put_str(fmap, t->src, (void*) (intptr_t) 1);
+        if (t->preprocess) {
+          if (code == 0 && _cc_on_compile_remote(ctx->n, t)) {
+            break;
+          }
+          code = code ? code : -1;
         }
-        if (slist == &ctx->sources) {
-          deps_add(&deps, code != 0 ? DEPS_TYPE_FILE_OUTDATED : DEPS_TYPE_FILE, 's', t->src, 0);
-          if (code == 0) {
-            _cc_deps_MMD_add(ctx->n, &deps, t->src, t->obj);
+        if (ctx->remote) {
+          char buf[PATH_MAX];
+          struct _cc_task_item *item = ulist_get(&t->items, 0);
+          unlink(_cc_preprocessed_path(item->obj, buf));
+          if (code != 0) {
+            unlink(item->obj); // Truncated by failed executor
           }
         }
-        _cc_task_destroy(t);
+        done += t->items.num;
+        _cc_task_report(ctx, t, code, done, total);
+        int64_t ms = (utils_current_time_ms() - t->ts) / t->items.num;
+        for (int k = 0; k < t->items.num; ++k) {
+          struct _cc_task_item *item = ulist_get(&t->items, k);
+          // Compiler continues with the rest of batch after failed source, it leaves no object
+          bool failed = code != 0 && (t->items.num == 1 || access(item->obj, F_OK) != 0);
+          if (failed) {
+            ++ctx->num_failed;
+            map_put_str(fmap, item->src, (void*) (intptr_t) 1);
+          } else {
+            map_put_str(times, item->src, (void*) (intptr_t) (ms + 1));
+          }
+          if (item->mod && item->mod->provides) {
+            item->mod->state = failed ? _CC_MOD_FAILED : _CC_MOD_DONE;
+          }
+          if (full) {
+            deps_add(&deps, failed ? DEPS_TYPE_FILE_OUTDATED : DEPS_TYPE_FILE, 's', item->src, 0);
+            if (!failed) {
+              _cc_deps_MMD_add(ctx->n, &deps, item->src, item->obj);
+              _cc_module_deps_add(ctx, modules, &deps, item);
+            }
+          }
+        }
+        _cc_task_destroy(ctx, t);
         ulist_remove(&tasks, j);
         break;
       }
     }
+    ulist_clear(&ctx->finished);
   }
 
-  if (slist != &ctx->sources) {
+  if (!full) {
     for (int i = 0; i < ctx->sources.num; ++i) {
-      char buf[PATH_MAX];
-      char *obj, *src = *(char**) ulist_get(&ctx->sources, i);
-      src = path_normalize_cwd(src, unit->cache_dir, buf);
-      bool incache = path_is_prefix_for(g_env.project.cache_dir, src, unit->cache_dir);
-      if (!incache) {
-        obj = path_relativize_cwd(unit->dir, src, unit->dir);
-        src = path_relativize_cwd(unit->cache_dir, src, unit->cache_dir);
-      } else {
-        obj = path_relativize_cwd(unit->cache_dir, src, unit->cache_dir);
-        src = xstrdup(obj);
-      }
-      char *p = strrchr(obj, '.');
-      akassert(p && p[1] != '\0');
-      p[1] = 'o';
-      p[2] = '\0';
-
-      bool failed = map_get(fmap, src) != 0;
-      deps_add(&deps, failed ? DEPS_TYPE_FILE_OUTDATED : DEPS_TYPE_FILE, 's', src, 0);
+      struct _cc_task_item item = { 0 };
+      _cc_task_item_init(unit, *(char**) ulist_get(&ctx->sources, i), &item);
+      bool failed = map_get(fmap, item.src) != 0;
+      deps_add(&deps, failed ? DEPS_TYPE_FILE_OUTDATED : DEPS_TYPE_FILE, 's', item.src, 0);
       if (!failed) {
-        _cc_deps_MMD_add(ctx->n, &deps, src, obj);
+        _cc_deps_MMD_add(ctx->n, &deps, item.src, item.obj);
+        item.mod = map_get(msrcs, item.src);
+        _cc_module_deps_add(ctx, modules, &deps, &item);
       }
-      free(obj);
-      free(src);
+      free(item.obj);
+      free(item.src);
     }
   }
 
+  _cc_times_save(ctx, times_path, times);
+
   deps_close(&deps);
   ulist_destroy_keep(&rlist);
+  ulist_destroy_keep(&queue);
   ulist_destroy_keep(&tasks);
   map_destroy(fmap);
+  map_destroy(hot);
+  map_destroy(msrcs);
+  map_destroy(times);
+  if (modules) {
+    map_destroy(modules);
+  }
 }
 
 static void _cc_on_consumed_resolved(const char *path_, void *d) {
@@ -480,6 +1452,7 @@ static void _cc_build(struct node *n) {
     ulist_push(&r.node_val_deps, &ctx->n_sources);
   }
 
+  node_add_io_val_deps(n, &r.node_val_deps);
   node_resolve(&r);
 
   if (ctx->num_failed) {
@@ -520,21 +1493,244 @@ static void _cc_source_add(struct node *n, const char *src) {
   node_product_add(n, obj, 0);
 }
 
+struct _cc_unity_member {
+  const char *path;  // Absolute path of source file
+  int group;         // Unity file index, -1 if source is detached
+};
+
+static bool _cc_unity_source_is_eligible(struct node *n, const char *path) {
+  const char *ext = strrchr(path, '.');
+  if (!ext || strchr(ext, '/')) {
+    return false;
+  }
+  ++ext;
+  if (n->kw == NODE_KW_CC) {
+    if (strcmp(ext, "c") != 0) {
+      return false;
+    }
+  } else if (  strcmp(ext, "cc") != 0 && strcmp(ext, "cpp") != 0 && strcmp(ext, "cxx") != 0
+            && strcmp(ext, "c++") != 0 && strcmp(ext, "C") != 0) {
+    return false;
+  }
+  return !path_is_prefix_for(g_env.project.cache_dir, path, 0) && path_is_file(path);
+}
+
+// Writes file only if its content is changed, so unchanged unity sources are not recompiled.
+static void _cc_unity_file_write(struct node *n, const char *path, struct xstr *xstr) {
+  struct value val = utils_file_as_buf(path, xstr_size(xstr) + 1);
+  bool changed = val.error || val.len != xstr_size(xstr) || memcmp(val.buf, xstr_ptr(xstr), val.len) != 0;
+  value_destroy(&val);
+  if (changed) {
+    int rc = utils_file_write_buf(path, xstr_ptr(xstr), xstr_size(xstr), false);
+    if (rc) {
+      node_fatal(rc, n, "Failed to write file: %s", path);
+    }
+  }
+}
+
+// Loads groups of the previous build, returns false if members or unity option are changed.
+static bool _cc_unity_state_load(const char *path, const char *spec, struct ulist *members) {
+  char buf[PATH_MAX + 32];
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  bool ret = false;
+  int i = 0;
+  if (!fgets(buf, sizeof(buf), f)) {
+    goto finish;
+  }
+  buf[strcspn(buf, "\n")] = '\0';
+  if (strcmp(buf, spec) != 0) {
+    goto finish;
+  }
+  for ( ; fgets(buf, sizeof(buf), f); ++i) {
+    int rc = 0;
+    buf[strcspn(buf, "\n")] = '\0';
+    char *p = strchr(buf, ' ');
+    if (!p || i >= members->num) {
+      goto finish;
+    }
+    *p++ = '\0';
+    struct _cc_unity_member *m = ulist_get(members, i);
+    int group = utils_strtol(buf, 10, &rc);
+    if (rc || group < -1 || strcmp(p, m->path) != 0) {
+      goto finish;
+    }
+    m->group = group;
+  }
+  ret = i == members->num;
+
+finish:
+  fclose(f);
+  return ret;
+}
+
+// Groups sources into unity files compiled as single translation units.
+//
+// Groups are kept stable between builds, so an edit of a source recompiles only its own unity file.
+// Source modified after its unity file is compiled is detached from the group and compiled
+// individually from now on, so subsequent edits do not recompile the whole group.
+// Detached sources are merged back when the list of sources or unity option is changed.
+static void _cc_unity_setup(struct node *n, const struct vlist *sources) {
+  struct _cc_ctx *ctx = n->impl;
+  struct unit *unit = unit_peek();
+  struct ulist members = { .usize = sizeof(struct _cc_unity_member) };
+  char buf[PATH_MAX];
+
+  const char *spec = node_value(ctx->n_unity->child);
+  if (!spec || *spec == '\0') {
+    node_fatal(AK_ERROR_SCRIPT, n, "unity { N } option requires a number of sources or a byte budget");
+  }
+  int rc = 0;
+  int64_t limit = utils_strtoll(spec, 10, &rc);
+  int64_t budget = 0;
+  if (rc) {
+    // Byte budget with `k` or `M` suffix
+    size_t len = strlen(spec);
+    char *num = pool_strdup(ctx->pool, spec);
+    char sfx = num[len - 1];
+    num[len - 1] = '\0';
+    rc = 0;
+    budget = utils_strtoll(num, 10, &rc);
+    if (rc == 0 && (sfx == 'k' || sfx == 'K')) {
+      budget *= 1024;
+    } else if (rc == 0 && sfx == 'M') {
+      budget *= 1024 * 1024;
+    } else {
+      budget = 0;
+    }
+    limit = 0;
+  }
+  if (limit <= 0 && budget <= 0) {
+    node_fatal(AK_ERROR_SCRIPT, n, "Invalid unity { N } option: '%s'", spec);
+  }
+
+  for (size_t i = 0; i < sources->num; ++i) {
+    const char *src = vlist_item(sources, i)->ptr;
+    if (!src || *src == '\0') {
+      continue;
+    }
+    const char *path = path_normalize_cwd(src, unit->dir, buf);
+    if (_cc_unity_source_is_eligible(n, path)) {
+      ulist_push(&members, &(struct _cc_unity_member) {
+        .path = pool_strdup(ctx->pool, path),
+        .group = -1
+      });
+    } else {
+      _cc_source_add(n, src);
+    }
+  }
+
+  const char *dir = pool_printf(ctx->pool, "%s/.unity-%s", unit->cache_dir, n->vfile + 1);
+  const char *state = pool_printf(ctx->pool, "%s/unity", dir);
+  const char *ext = n->kw == NODE_KW_CC ? "c" : "cpp";
+  rc = path_mkdirs(dir);
+  if (rc) {
+    node_fatal(rc, n, "Failed to create directory: %s", dir);
+  }
+
+  int ngroups = 0;
+  if (!_cc_unity_state_load(state, spec, &members)) {
+    int64_t cnt = 0, bytes = 0;
+    for (int i = 0; i < members.num; ++i) {
+      struct _cc_unity_member *m = ulist_get(&members, i);
+      if (cnt && ((limit && cnt >= limit) || (budget && bytes >= budget))) {
+        ++ngroups;
+        cnt = 0;
+        bytes = 0;
+      }
+      if (budget) {
+        struct akpath_stat st;
+        if (!path_stat(m->path, &st)) {
+          bytes += st.size;
+        }
+      }
+      m->group = ngroups;
+      ++cnt;
+    }
+  } else {
+    for (int i = 0; i < members.num; ++i) {
+      struct _cc_unity_member *m = ulist_get(&members, i);
+      if (m->group >= 0) {
+        uint64_t mtime = path_mtime(pool_printf(ctx->pool, "%s/unity_%d.o", dir, m->group));
+        if (mtime && path_mtime(m->path) > mtime) {
+          if (g_env.verbose) {
+            node_info(n, "Detached from unity_%d.%s: %s", m->group, ext, m->path);
+          }
+          m->group = -1;
+        }
+      }
+    }
+  }
+
+  struct xstr *xstr = xstr_create_empty();
+  xstr_printf(xstr, "%s\n", spec);
+  for (int i = 0; i < members.num; ++i) {
+    struct _cc_unity_member *m = ulist_get(&members, i);
+    xstr_printf(xstr, "%d %s\n", m->group, m->path);
+    if (m->group >= ngroups) {
+      ngroups = m->group + 1;
+    }
+  }
+  _cc_unity_file_write(n, state, xstr);
+
+  for (int g = 0; g < ngroups; ++g) {
+    xstr_clear(xstr);
+    for (int i = 0; i < members.num; ++i) {
+      struct _cc_unity_member *m = ulist_get(&members, i);
+      if (m->group == g) {
+        xstr_printf(xstr, "#include \"%s\"\n", m->path);
+      }
+    }
+    if (xstr_size(xstr)) {
+      const char *path = pool_printf(ctx->pool, "%s/unity_%d.%s", dir, g, ext);
+      _cc_unity_file_write(n, path, xstr);
+      _cc_source_add(n, path);
+    }
+  }
+  for (int i = 0; i < members.num; ++i) {
+    struct _cc_unity_member *m = ulist_get(&members, i);
+    if (m->group == -1) {
+      _cc_source_add(n, m->path);
+    }
+  }
+
+  xstr_destroy(xstr);
+  ulist_destroy_keep(&members);
+}
+
 static void _cc_setup(struct node *n) {
   _cc_cdb_init(n);
 
   struct _cc_ctx *ctx = n->impl;
-  const char *val = node_value(ctx->n_sources);
-  if (is_vlist(val)) {
-    struct vlist_iter iter;
-    vlist_iter_init(val, &iter);
-    while (vlist_iter_next(&iter)) {
-      char buf[PATH_MAX];
-      utils_strnncpy(buf, iter.item, iter.len, sizeof(buf));
-      _cc_source_add(n, buf);
+  if (ctx->n_modules) {
+    if (n->kw == NODE_KW_CXX) {
+      ctx->modules = true;
+      if (ctx->n_modules->child) {
+        const char *scanner = node_value(ctx->n_modules->child);
+        if (scanner && *scanner != '\0') {
+          ctx->scanner = pool_strdup(ctx->pool, scanner);
+        }
+      }
+      if (ctx->n_unity) {
+        node_warn(n, "unity { ... } option is ignored since C++ modules are enabled");
+        ctx->n_unity = 0;
+      }
+    } else {
+      node_warn(n, "modules { ... } option is supported only by cxx rule");
+    }
+  }
+
+  const struct vlist *sources = node_list(ctx->n_sources);
+  if (sources) {
+    if (ctx->n_unity && ctx->n_unity->child) {
+      _cc_unity_setup(n, sources);
+    } else {
+      for (size_t i = 0; i < sources->num; ++i) {
+        _cc_source_add(n, vlist_item(sources, i)->ptr);
+      }
     }
-  } else {
-    _cc_source_add(n, val);
   }
   if (ctx->n_cc) {
     const char *cc = node_value(ctx->n_cc);
@@ -543,16 +1739,15 @@ static void _cc_setup(struct node *n) {
     }
   }
   if (!ctx->cc) {
-    const char *key = strcmp(n->value, "cc") == 0 ? "CC" : "CXX";
-    if (key) {
-      ctx->cc = pool_strdup(ctx->pool, node_env_get(n, key));
-      if (g_env.verbose && ctx->cc) {
-        node_info(n, "Found '%s' compiler in ${%s}", ctx->cc, key);
-      }
+    const char *key = n->kw == NODE_KW_CC ? "CC" : "CXX";
+    ctx->cc_env = key;
+    ctx->cc = pool_strdup(ctx->pool, node_env_get(n, key));
+    if (g_env.verbose && ctx->cc) {
+      node_info(n, "Found '%s' compiler in ${%s}", ctx->cc, key);
     }
   }
   if (!ctx->cc) {
-    if (strcmp(n->value, "cc") == 0) {
+    if (n->kw == NODE_KW_CC) {
       ctx->cc = "cc";
     } else {
       ctx->cc = "c++";
@@ -567,7 +1762,7 @@ static void _cc_setup(struct node *n) {
     objskey = node_value(ctx->n_objects->child);
   }
   if (!objskey) {
-    if (strcmp(n->value, "cc") == 0) {
+    if (n->kw == NODE_KW_CC) {
       objskey = "CC_OBJS";
     } else {
       objskey = "CXX_OBJS";
@@ -578,6 +1773,29 @@ static void _cc_setup(struct node *n) {
   }
 
   ctx->objskey = pool_strdup(ctx->pool, objskey);
+
+  if (ctx->n_batch && ctx->n_batch->child) {
+    int rc = 0;
+    const char *val = node_value(ctx->n_batch->child);
+    ctx->batch = val ? utils_strtol(val, 10, &rc) : 0;
+    if (rc || ctx->batch < 1) {
+      node_fatal(AK_ERROR_SCRIPT, n, "Invalid batch { N } option: '%s'", val ? val : "");
+    }
+    if (g_env.verbose) {
+      node_info(n, "Batch of sources per compiler invocation: %d", ctx->batch);
+    }
+  }
+
+  if (ctx->n_pch && ctx->n_pch->child) {
+    const char *header = node_value(ctx->n_pch->child);
+    if (header && *header != '\0') {
+      char buf[PATH_MAX];
+      ctx->pch_header = pool_strdup(ctx->pool, path_normalize_cwd(header, unit_peek()->dir, buf));
+      if (g_env.verbose) {
+        node_info(n, "Precompiled header: %s", ctx->pch_header);
+      }
+    }
+  }
   char *objs = ulist_to_vlist(&ctx->objects);
   node_env_set(n, ctx->objskey, objs);
   free(objs);
@@ -586,12 +1804,24 @@ static void _cc_setup(struct node *n) {
 static void _cc_init(struct node *n) {
   struct _cc_ctx *ctx = n->impl;
   for (struct node *nn = n->child; nn; nn = nn->next) {
-    if (strcmp(nn->value, "consumes") == 0) {
+    if (nn->kw == NODE_KW_CONSUMES) {
       ctx->n_consumes = nn;
       continue;
-    } else if (strcmp(nn->value, "objects") == 0) {
+    } else if (nn->kw == NODE_KW_OBJECTS) {
       ctx->n_objects = nn;
       continue;
+    } else if (nn->kw == NODE_KW_PCH) {
+      ctx->n_pch = nn;
+      continue;
+    } else if (nn->kw == NODE_KW_UNITY) {
+      ctx->n_unity = nn;
+      continue;
+    } else if (nn->kw == NODE_KW_BATCH) {
+      ctx->n_batch = nn;
+      continue;
+    } else if (nn->kw == NODE_KW_MODULES) {
+      ctx->n_modules = nn;
+      continue;
     }
     if (!ctx->n_sources) {
       ctx->n_sources = nn;
@@ -620,17 +1850,23 @@ static void _cc_dispose(struct node *n) {
     ulist_destroy_keep(&ctx->sources);
     ulist_destroy_keep(&ctx->objects);
     ulist_destroy_keep(&ctx->consumes);
+    ulist_destroy_keep(&ctx->finished);
+    map_destroy(ctx->outputs);
     pool_destroy(ctx->pool);
   }
 }
 
+static const struct node_ops _cc_ops = {
+  .init       = _cc_init,
+  .setup      = _cc_setup,
+  .build      = _cc_build,
+  .post_build = _cc_post_build,
+  .dispose    = _cc_dispose,
+};
+
 int node_cc_setup(struct node *n) {
   n->flags |= NODE_FLG_IN_CACHE;
-  n->init = _cc_init;
-  n->setup = _cc_setup;
-  n->build = _cc_build;
-  n->post_build = _cc_post_build;
-  n->dispose = _cc_dispose;
+  n->ops = &_cc_ops;
   struct pool *pool = pool_create_empty();
   struct _cc_ctx *ctx = pool_alloc(pool, sizeof(*ctx));
   *ctx = (struct _cc_ctx) {
@@ -639,6 +1875,8 @@ int node_cc_setup(struct node *n) {
     .sources = { .usize = sizeof(char*) },
     .objects = { .usize = sizeof(char*) },
     .consumes = { .usize = sizeof(char*) },
+    .finished = { .usize = sizeof(struct spawn*) },
+    .outputs = map_create_u64(0),
   };
   n->impl = ctx;
   return 0;
@@ -4,12 +4,16 @@
 #include "log.h"
 #include "pool.h"
 #include "paths.h"
+#include "pathid.h"
 #include "spawn.h"
 #include "deps.h"
+#include "alloc.h"
+#include "nodes.h"
 
 #include <limits.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #endif
 
 static void _check_stdout_handler(char *buf, size_t buflen, struct spawn *s) {
@@ -81,7 +85,7 @@ static char* _resolve_check_path(struct pool *pool, struct node *n, const char *
     struct unit_ctx *c = (struct unit_ctx*) ulist_get(&g_env.stack_units, i);
     struct unit *u = c->unit;
     snprintf(buf, sizeof(buf), "%s/.autark/%s", u->dir, script);
-    if (path_is_exist(buf)) {
+    if (pathid_is_exist(buf)) {
       *out_u = u;
       return pool_strdup(pool, buf);
     }
@@ -90,15 +94,15 @@ static char* _resolve_check_path(struct pool *pool, struct node *n, const char *
   return 0;
 }
 
-static void _check_script(struct node *n) {
-  const char *script = node_value(n);
-  if (g_env.verbose) {
-    node_info(n->parent, "%s", script);
-  }
-  struct unit *parent = 0;
-  struct pool *pool = pool_create(on_unit_pool_destroy);
+struct _check_lazy {
+  char *path;          // Resolved check script path
+  struct unit *parent; // Unit where check script is located
+  bool done;
+};
 
-  char *path = _resolve_check_path(pool, n, script, &parent);
+static void _check_script_run(struct node *n, const char *path_, struct unit *parent) {
+  struct pool *pool = pool_create(on_unit_pool_destroy);
+  char *path = pool_strdup(pool, path_);
   const char *vpath = pool_printf(pool, "%s/.autark/%s", parent->dir, n->vfile);
 
   struct unit *unit = unit_create(vpath, 0, pool);
@@ -128,13 +132,100 @@ static void _check_script(struct node *n) {
   pool_destroy(pool);
 }
 
+static struct unit* _check_unit(struct node *n) {
+  for ( ; n; n = n->parent) {
+    if (n->unit) {
+      return n->unit;
+    }
+  }
+  return 0;
+}
+
+static void _check_provides_each(struct node *n, void (*fn)(struct node*, struct unit*, const char*)) {
+  struct node *pn = node_find_direct_child(n, NODE_TYPE_BAG, NODE_KW_PROVIDES);
+  struct unit *unit = _check_unit(n);
+  for (struct node *nn = pn ? pn->child : 0; nn; nn = nn->next) {
+    const struct vlist *l = node_list(nn);
+    for (size_t i = 0; l && i < l->num; ++i) {
+      fn(n, unit, vlist_item(l, i)->ptr);
+    }
+  }
+}
+
+static void _check_provides_register(struct node *n, struct unit *unit, const char *key) {
+  if (g_env.verbose) {
+    node_info(n, "Provides %s", key);
+  }
+  unit_env_set_node(unit, key, n, TAG_CHECK);
+}
+
+static void _check_provides_cleanup(struct node *n, struct unit *unit, const char *key) {
+  // Variable was not set by check script
+  struct unit_env_item *item = map_get(unit->env, key);
+  if (item && item->tag == TAG_CHECK && item->n == n) {
+    unit_env_remove(unit, key);
+  }
+}
+
+void node_check_provide(struct node *n) {
+  struct _check_lazy *c = n->impl;
+  if (!c || c->done) {
+    return;
+  }
+  c->done = true;
+  _check_script_run(n, c->path, c->parent);
+  _check_provides_each(n, _check_provides_cleanup);
+}
+
+static void _check_script(struct node *n) {
+  const char *script = node_value(n);
+  if (g_env.verbose) {
+    node_info(n->parent, "%s", script);
+  }
+  struct unit *parent = 0;
+  struct pool *pool = pool_create_empty();
+  char *path = _resolve_check_path(pool, n, script, &parent);
+
+  if (node_find_direct_child(n, NODE_TYPE_BAG, NODE_KW_PROVIDES)) {
+    // Check is executed on the first lookup of variable it provides
+    struct _check_lazy *c = xcalloc(1, sizeof(*c));
+    c->path = xstrdup(path);
+    c->parent = parent;
+    n->impl = c;
+    _check_provides_each(n, _check_provides_register);
+  } else {
+    _check_script_run(n, path, parent);
+  }
+  pool_destroy(pool);
+}
+
 static void _check_init(struct node *n) {
+  if (g_env.project.options) {
+    // Listing of project options never spawns checks
+    return;
+  }
   for (struct node *nn = n->child; nn; nn = nn->next) {
     _check_script(nn);
   }
 }
 
+static void _check_dispose(struct node *n) {
+  for (struct node *nn = n->child; nn; nn = nn->next) {
+    struct _check_lazy *c = nn->impl;
+    if (c) {
+      free(c->path);
+      free(c);
+      nn->impl = 0;
+    }
+  }
+}
+
+static const struct node_ops _check_ops = {
+  .init = _check_init,
+  .dispose = _check_dispose,
+};
+
 int node_check_setup(struct node *n) {
-  n->init = _check_init;
+  n->ops = &_check_ops;
   return 0;
 }
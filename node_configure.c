@@ -195,7 +195,14 @@ static void _configure_on_resolve(struct node_resolve *r) {
   if (rc) {
     node_fatal(rc, n, "Failed to open dependency file: %s", r->deps_path_tmp);
   }
-  node_add_unit_deps(n, &deps);
+
+  for (int i = 0; i < r->node_val_deps.num; ++i) {
+    struct node *nv = *(struct node**) ulist_get(&r->node_val_deps, i);
+    const char *val = node_value(nv);
+    if (val) {
+      deps_add(&deps, DEPS_TYPE_NODE_VALUE, 0, val, i);
+    }
+  }
 
   if (r->resolve_outdated.num) {
     for (int i = 0; i < r->resolve_outdated.num; ++i) {
@@ -258,7 +265,9 @@ static void _configure_build(struct node *n) {
     .path = n->vfile,
     .on_init = _configure_on_resolve_init,
     .on_resolve = _configure_on_resolve,
+    .node_val_deps = { .usize = sizeof(struct node*) },
   };
+  node_add_io_val_deps(n, &r.node_val_deps);
   node_resolve(&r);
 }
 
@@ -322,11 +331,15 @@ static void _configure_dispose(struct node *n) {
   }
 }
 
+static const struct node_ops _configure_ops = {
+  .init    = _configure_init,
+  .setup   = _configure_setup,
+  .build   = _configure_build,
+  .dispose = _configure_dispose,
+};
+
 int node_configure_setup(struct node *n) {
   n->flags |= NODE_FLG_IN_CACHE;
-  n->dispose = _configure_dispose;
-  n->init = _configure_init;
-  n->setup = _configure_setup;
-  n->build = _configure_build;
+  n->ops = &_configure_ops;
   return 0;
 }
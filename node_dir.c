@@ -1,37 +1,21 @@
 #ifndef _AMALGAMATE_
 #include "script.h"
-#include "xstr.h"
 #include "env.h"
 #include "paths.h"
 #include "utils.h"
 #include <unistd.h>
 #endif
 
-static void _node_dir_normalize_add(const char *dir, struct xstr *xstr, const char *v, char buf[PATH_MAX]) {
-  if (xstr_size(xstr)) {
-    if (!is_vlist(xstr_ptr(xstr))) {
-      xstr_unshift(xstr, "\1", 1);
-    }
-    xstr_cat2(xstr, "\1", 1);
-  }
+static void _dir_add(struct vlist *l, const char *dir, const char *v, char buf[PATH_MAX]) {
   char *path = path_normalize_cwd(v, dir, buf);
-  xstr_cat(xstr, path);
+  vlist_add(l, path, strlen(path));
 }
 
-static const char* _dir_value(struct node *n) {
-  struct node_foreach *fe = node_find_parent_foreach(n);
-  if (fe) {
-    free(n->impl);
-    n->impl = 0;
-  }
-  if (n->impl) {
-    return n->impl;
-  }
-
+static struct vlist* _dir_list(struct node *n) {
   char buf[PATH_MAX];
   struct unit *root = unit_root();
   struct unit *unit = unit_peek();
-  struct xstr *xstr = xstr_create_empty();
+  struct vlist *l = vlist_create();
   const char *dir = 0;
 
   if (n->value[0] == 'S') {
@@ -49,39 +33,40 @@ static const char* _dir_value(struct node *n) {
   }
 
   for (struct node *nn = n->child; nn; nn = nn->next) {
-    const char *v = node_value(nn);
-    if (is_vlist(v)) {
-      struct vlist_iter iter;
-      vlist_iter_init(v, &iter);
-      while (vlist_iter_next(&iter)) {
-        if (iter.len) {
-          char vbuf[iter.len + 1];
-          utils_strnncpy(vbuf, iter.item, iter.len, iter.len + 1);
-          _node_dir_normalize_add(dir, xstr, vbuf, buf);
-        }
+    const struct vlist *v = node_list(nn);
+    if (!v) {
+      continue;
+    }
+    if (vlist_is_list(v)) {
+      for (size_t i = 0; i < v->num; ++i) {
+        _dir_add(l, dir, vlist_item(v, i)->ptr, buf);
       }
     } else {
-      _node_dir_normalize_add(dir, xstr, v, buf);
+      _dir_add(l, dir, vlist_str(v), buf);
     }
   }
 
-  if (xstr_size(xstr) == 0) {
-    _node_dir_normalize_add(dir, xstr, ".", buf);
+  if (l->num == 0) {
+    _dir_add(l, dir, ".", buf);
   }
-
-  n->impl = xstr_destroy_keep_ptr(xstr);
-  return n->impl;
+  if (l->num == 1) {
+    l->scalar = true;
+  }
+  return l;
 }
 
-static void _dir_dispose(struct node *n) {
-  if (n->impl) {
-    free(n->impl);
-  }
+static const char* _dir_value(struct node *n) {
+  return vlist_str(node_list(n));
 }
 
+static const struct node_ops _dir_ops = {
+  .value_get  = _dir_value,
+  .list_get   = _dir_list,
+  .value_memo = true,
+};
+
 int node_dir_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->value_get = _dir_value;
-  n->dispose = _dir_dispose;
+  n->ops = &_dir_ops;
   return 0;
 }
@@ -48,43 +48,52 @@ static void _echo(struct node *n) {
 
 static void _echo_init(struct node *n) {
   struct _echo_ctx *ctx = n->impl;
-  _echo(ctx->n_init);
+  if (ctx->n_init) {
+    _echo(ctx->n_init);
+  }
 }
 
 static void _echo_setup(struct node *n) {
   struct _echo_ctx *ctx = n->impl;
-  _echo(ctx->n_setup);
+  if (ctx->n_setup) {
+    _echo(ctx->n_setup);
+  }
 }
 
 static void _echo_build(struct node *n) {
   struct _echo_ctx *ctx = n->impl;
-  _echo(ctx->n_build);
+  if (ctx->n_build) {
+    _echo(ctx->n_build);
+  }
 }
 
 static void _echo_dispose(struct node *n) {
   free(n->impl);
 }
 
+static const struct node_ops _echo_ops = {
+  .init    = _echo_init,
+  .setup   = _echo_setup,
+  .build   = _echo_build,
+  .dispose = _echo_dispose,
+};
+
 int node_echo_setup(struct node *n) {
   struct _echo_ctx *ctx = xcalloc(1, sizeof(*ctx));
   n->impl = ctx;
-  n->dispose = _echo_dispose;
+  n->ops = &_echo_ops;
   for (struct node *nn = n->child; nn; nn = nn->next) {
     if (nn->type == NODE_TYPE_BAG) {
-      if (!n->build && strcmp(nn->value, "build") == 0) {
-        n->build = _echo_build;
+      if (!ctx->n_build && nn->kw == NODE_KW_BUILD) {
         ctx->n_build = nn;
-      } else if (!n->setup && strcmp(nn->value, "setup") == 0) {
-        n->setup = _echo_setup;
+      } else if (!ctx->n_setup && nn->kw == NODE_KW_SETUP) {
         ctx->n_setup = nn;
-      } else if (!n->init && strcmp(nn->value, "init") == 0) {
-        n->init = _echo_init;
+      } else if (!ctx->n_init && nn->kw == NODE_KW_INIT) {
         ctx->n_init = nn;
       }
     }
   }
-  if (!(n->init || n->setup || n->build)) {
-    n->build = _echo_build;
+  if (!(ctx->n_init || ctx->n_setup || ctx->n_build)) {
     ctx->n_build = n;
   }
   return 0;
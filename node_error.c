@@ -17,7 +17,11 @@ static void _error_setup(struct node *n) {
   node_fatal(AK_ERROR_FAIL, n, xstr_ptr(xstr));
 }
 
+static const struct node_ops _error_ops = {
+  .setup = _error_setup,
+};
+
 int node_error_setup(struct node *n) {
-  n->setup = _error_setup;
+  n->ops = &_error_ops;
   return 0;
 }
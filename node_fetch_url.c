@@ -2,6 +2,7 @@
 #include "env.h"
 #include "script.h"
 #include "paths.h"
+#include "pathid.h"
 #include "fetchreg.h"
 #endif
 
@@ -27,7 +28,7 @@ static const char* _fetch_url_value_get(struct node *n) {
   }
   char path[PATH_MAX];
   snprintf(path, sizeof(path), "%s/" AUTARK_FETCHED_REG_DIST, g_env.project.cache_overlay_dir);
-  if (!path_is_file(path)) {
+  if (!pathid_is_file(path)) {
     return url;
   }
   struct fetchreg *reg;
@@ -46,9 +47,13 @@ static void _fetch_url_dispose(struct node *n) {
   }
 }
 
+static const struct node_ops _fetch_url_ops = {
+  .value_get = _fetch_url_value_get,
+  .dispose   = _fetch_url_dispose,
+};
+
 int node_fetch_url_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->value_get = _fetch_url_value_get;
-  n->dispose = _fetch_url_dispose;
+  n->ops = &_fetch_url_ops;
   return 0;
 }
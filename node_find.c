@@ -4,7 +4,9 @@
 #include "env.h"
 #include "utils.h"
 #include "paths.h"
+#include "pathid.h"
 #include "alloc.h"
+#include "manifest.h"
 #include <string.h>
 #endif
 
@@ -37,7 +39,7 @@ static void _library_find(struct node *n) {
     }
   }
 
-  const char *home = getenv("HOME");
+  const char *home = manifest_getenv("HOME");
   if (home) {
     xstr_printf(dirs, "\1%s/.local/%s/", home, ldir);
     if (sld) {
@@ -67,7 +69,7 @@ static void _library_find(struct node *n) {
       char buf[PATH_MAX];
       snprintf(buf, sizeof(buf), "%.*s%.*s",
                (int) iter_dirs.len, iter_dirs.item, (int) iter_names.len, iter_names.item);
-      if (path_is_exist(buf)) {
+      if (pathid_is_exist(buf)) {
         n->impl = xstrdup(buf);
         goto finish;
       }
@@ -110,10 +112,10 @@ static const char* _find_value_get(struct node *n) {
 
 static struct unit* _unit_for_find(struct node *n, struct node *nn, const char **keyp) {
   if (nn->type == NODE_TYPE_BAG) {
-    if (strcmp(nn->value, "root") == 0) {
+    if (nn->kw == NODE_KW_ROOT) {
       *keyp = node_value(nn->child);
       return unit_root();
-    } else if (strcmp(nn->value, "parent") == 0) {
+    } else if (nn->kw == NODE_KW_PARENT) {
       *keyp = node_value(nn->child);
       return unit_parent(n);
     }
@@ -140,10 +142,14 @@ static void _find_dispose(struct node *n) {
   n->impl = 0;
 }
 
+static const struct node_ops _find_ops = {
+  .value_get = _find_value_get,
+  .init      = _find_init,
+  .dispose   = _find_dispose,
+};
+
 int node_find_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->init = _find_init;
-  n->value_get = _find_value_get;
-  n->dispose = _find_dispose;
+  n->ops = &_find_ops;
   return 0;
 }
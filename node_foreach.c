@@ -36,10 +36,14 @@ static void _foreach_dispose(struct node *n) {
 static void _foreach_init(struct node *n) {
 }
 
+static const struct node_ops _foreach_ops = {
+  .init    = _foreach_init,
+  .setup   = _foreach_setup,
+  .dispose = _foreach_dispose,
+};
+
 int node_foreach_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->init = _foreach_init;
-  n->setup = _foreach_setup;
-  n->dispose = _foreach_dispose;
+  n->ops = &_foreach_ops;
   return 0;
 }
@@ -129,7 +129,7 @@ static bool _if_cond_eval(struct node *n, struct node *mn) {
 }
 
 static inline bool _if_node_is_else(struct node *n) {
-  return n && n->value && strcmp(n->value, "else") == 0;
+  return n && n->kw == NODE_KW_ELSE;
 }
 
 static void _if_pull_else(struct node *n) {
@@ -218,10 +218,14 @@ static void _if_init(struct node *n) {
   } else {
     _if_pull_else(n);
   }
-  n->init = 0; // Protect me from second call in any way
+  n->ops = &node_ops_none; // Protect me from second call in any way
 }
 
+static const struct node_ops _if_ops = {
+  .init = _if_init,
+};
+
 int node_if_setup(struct node *n) {
-  n->init = _if_init;
+  n->ops = &_if_ops;
   return 0;
 }
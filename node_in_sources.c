@@ -29,8 +29,12 @@ static void _in_sources_init(struct node *n) {
   }
 }
 
+static const struct node_ops _in_sources_ops = {
+  .init = _in_sources_init,
+};
+
 int node_in_sources_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->init = _in_sources_init;
+  n->ops = &_in_sources_ops;
   return 0;
 }
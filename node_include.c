@@ -35,10 +35,14 @@ static void _include_init(struct node *n) {
   }
   node_init(cn); // Explicitly init conditional node since in script init worflow 'include' initiated first.
   _include(n, cn);
-  n->init = 0;
+  n->ops = &node_ops_none;
 }
 
+static const struct node_ops _include_ops = {
+  .init = _include_init,
+};
+
 int node_include_setup(struct node *n) {
-  n->init = _include_init;
+  n->ops = &_include_ops;
   return 0;
 }
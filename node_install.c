@@ -208,7 +208,6 @@ static void _install_on_resolve(struct node_resolve *r) {
   if (rc) {
     node_fatal(rc, n, "Failed to open dependency file: %s", r->deps_path_tmp);
   }
-  node_add_unit_deps(n, &deps);
   deps_add_env(&deps, 0, "INSTALL_PREFIX", g_env.install.prefix_dir);
 
   for (int i = 0; i < r->node_val_deps.num; ++i) {
@@ -303,6 +302,10 @@ static void _install_post_build(struct node *n) {
   }
 }
 
+static const struct node_ops _install_ops = {
+  .post_build = _install_post_build,
+};
+
 int node_install_setup(struct node *n) {
   if (!g_env.install.enabled || !g_env.install.prefix_dir) {
     return 0;
@@ -312,6 +315,6 @@ int node_install_setup(struct node *n) {
   } else {
     n->flags |= NODE_FLG_IN_CACHE;
   }
-  n->post_build = _install_post_build;
+  n->ops = &_install_ops;
   return 0;
 }
@@ -6,16 +6,18 @@
 #include <stdlib.h>
 #endif
 
-static const char* _join_value(struct node *n) {
-  struct node_foreach *fe = node_find_parent_foreach(n);
-  if (fe) {
-    free(n->impl);
-    n->impl = 0;
+static void _join_cat(struct xstr *xstr, const struct vlist *l) {
+  if (!l) {
+    return;
   }
-  if (n->impl) {
-    return n->impl;
+  for (size_t i = 0; i < l->num; ++i) {
+    const struct vlist_item *item = vlist_item(l, i);
+    xstr_cat2(xstr, item->ptr, item->len);
   }
+}
 
+static struct vlist* _join_list(struct node *n) {
+  struct vlist *ret = 0;
   struct xstr *xstr = xstr_create_empty();
 
   int c = 0;
@@ -27,64 +29,68 @@ static const char* _join_value(struct node *n) {
   }
 
   if (c == 2) {
-    const char *vpair[] = { node_value(pair[0]), node_value(pair[1]) };
-    if ((vpair[0] && !is_vlist(vpair[0]) && is_vlist(vpair[1]))) {
-      const char *prefix = vpair[0];
-      size_t prefix_len = strlen(prefix);
-      struct vlist_iter iter;
-      vlist_iter_init(vpair[1], &iter);
-      while (vlist_iter_next(&iter)) {
-        xstr_cat2(xstr, "\1", 1);
-        xstr_cat2(xstr, prefix, prefix_len);
-        xstr_cat2(xstr, iter.item, iter.len);
+    const struct vlist *lpair[] = { node_list(pair[0]), node_list(pair[1]) };
+    const struct vlist *list = 0, *affix = 0;
+    if (lpair[0] && lpair[1]) {
+      if (!vlist_is_list(lpair[0]) && vlist_is_list(lpair[1])) {
+        affix = lpair[0];
+        list = lpair[1];
+      } else if (!vlist_is_list(lpair[1]) && vlist_is_list(lpair[0])) {
+        list = lpair[0];
+        affix = lpair[1];
       }
-      n->impl = xstr_destroy_keep_ptr(xstr);
-      return n->impl;
-    } else if (vpair[1] && !is_vlist(vpair[1]) && is_vlist(vpair[0])) {
-      const char *suffix = vpair[1];
-      size_t suffix_len = strlen(suffix);
-      struct vlist_iter iter;
-      vlist_iter_init(vpair[0], &iter);
-      while (vlist_iter_next(&iter)) {
-        xstr_cat2(xstr, "\1", 1);
-        xstr_cat2(xstr, iter.item, iter.len);
-        xstr_cat2(xstr, suffix, suffix_len);
+    }
+    if (list) {
+      const char *av = vlist_str(affix);
+      size_t av_len = strlen(av);
+      ret = vlist_create();
+      for (size_t i = 0; i < list->num; ++i) {
+        const struct vlist_item *item = vlist_item(list, i);
+        xstr_clear(xstr);
+        if (affix == lpair[0]) {
+          xstr_cat2(xstr, av, av_len);
+          xstr_cat2(xstr, item->ptr, item->len);
+        } else {
+          xstr_cat2(xstr, item->ptr, item->len);
+          xstr_cat2(xstr, av, av_len);
+        }
+        vlist_add(ret, xstr_ptr(xstr), xstr_size(xstr));
       }
-      n->impl = xstr_destroy_keep_ptr(xstr);
-      return n->impl;
+      xstr_destroy(xstr);
+      return ret;
     }
   }
 
-  bool list = n->value[0] == '.';
-  for (struct node *nn = n->child; nn; nn = nn->next) {
-    if (list) {
-      xstr_cat(xstr, "\1");
+  if (n->value[0] == '.') {
+    ret = vlist_create();
+    for (struct node *nn = n->child; nn; nn = nn->next) {
+      xstr_clear(xstr);
+      _join_cat(xstr, node_list(nn));
+      vlist_add(ret, xstr_ptr(xstr), xstr_size(xstr));
     }
-    const char *val = node_value(nn);
-    if (is_vlist(val)) {
-      struct vlist_iter iter;
-      vlist_iter_init(val, &iter);
-      while (vlist_iter_next(&iter)) {
-        xstr_cat2(xstr, iter.item, iter.len);
-      }
-    } else {
-      xstr_cat(xstr, val);
+  } else {
+    for (struct node *nn = n->child; nn; nn = nn->next) {
+      _join_cat(xstr, node_list(nn));
     }
+    ret = vlist_create_scalar(xstr_ptr(xstr));
   }
 
-  n->impl = xstr_destroy_keep_ptr(xstr);
-  return n->impl;
+  xstr_destroy(xstr);
+  return ret;
 }
 
-static void _join_dispose(struct node *n) {
-  if (n->impl) {
-    free(n->impl);
-  }
+static const char* _join_value(struct node *n) {
+  return vlist_str(node_list(n));
 }
 
+static const struct node_ops _join_ops = {
+  .value_get  = _join_value,
+  .list_get   = _join_list,
+  .value_memo = true,
+};
+
 int node_join_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->value_get = _join_value;
-  n->dispose = _join_dispose;
+  n->ops = &_join_ops;
   return 0;
 }
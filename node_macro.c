@@ -58,9 +58,13 @@ static void _macro_dispose(struct node *n) {
   }
 }
 
+static const struct node_ops _macro_ops = {
+  .init    = _macro_init,
+  .dispose = _macro_dispose,
+};
+
 int node_macro_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->init = _macro_init;
-  n->dispose = _macro_dispose;
+  n->ops = &_macro_ops;
   return 0;
 }
@@ -60,7 +60,7 @@ static void _meta_on_entry(struct node *n, struct node *e) {
 
 static void _meta_init(struct node *n) {
   for (struct node *nn = n->child; nn; nn = nn->next) {
-    if (strcmp(nn->value, "let") == 0) {
+    if (nn->kw == NODE_KW_LET) {
       _meta_on_let(n, nn);
     } else {
       _meta_on_entry(n, nn);
@@ -68,7 +68,11 @@ static void _meta_init(struct node *n) {
   }
 }
 
+static const struct node_ops _meta_ops = {
+  .init = _meta_init,
+};
+
 int node_meta_setup(struct node *n) {
-  n->init = _meta_init;
+  n->ops = &_meta_ops;
   return 0;
 }
@@ -127,9 +127,9 @@ static void _run_on_resolve_exec(struct node_resolve *r, struct node *ncmd) {
 
 static void _run_on_resolve_do(struct node_resolve *r, struct node *n) {
   for (struct node *nn = n->child; nn; nn = nn->next) {
-    if (strcmp(nn->value, "exec") == 0) {
+    if (nn->kw == NODE_KW_EXEC) {
       _run_on_resolve_exec(r, nn->child);
-    } else if (strcmp(nn->value, "shell") == 0) {
+    } else if (nn->kw == NODE_KW_SHELL) {
       _run_on_resolve_shell(r, nn->child);
     }
   }
@@ -197,8 +197,6 @@ static void _run_on_resolve(struct node_resolve *r) {
   if (rc) {
     node_fatal(rc, n, "Failed to open dependency file: %s", r->deps_path_tmp);
   }
-  node_add_unit_deps(n, &deps);
-
   for (int i = 0; i < r->node_val_deps.num; ++i) {
     struct node *nv = *(struct node**) ulist_get(&r->node_val_deps, i);
     const char *val = node_value(nv);
@@ -227,7 +225,7 @@ static bool _run_setup_foreach(struct node *n) {
   if (!fe) {
     return false;
   }
-  struct node *pn = node_find_direct_child(n, NODE_TYPE_BAG, "produces");
+  struct node *pn = node_find_direct_child(n, NODE_TYPE_BAG, NODE_KW_PRODUCES);
   if (pn && pn->child) {
     struct vlist_iter iter;
     vlist_iter_init(fe->items, &iter);
@@ -255,7 +253,7 @@ static void _run_setup(struct node *n) {
   if (_run_setup_foreach(n)) {
     return;
   }
-  struct node *nn = node_find_direct_child(n, NODE_TYPE_BAG, "produces");
+  struct node *nn = node_find_direct_child(n, NODE_TYPE_BAG, NODE_KW_PRODUCES);
   if (nn && nn->child) {
     for (nn = nn->child; nn; nn = nn->next) {
       if (node_is_can_be_value(nn)) {
@@ -284,7 +282,7 @@ static void _run_on_consumed_resolved_foreach(const char *path_, void *d) {
 static void _run_on_resolve_init(struct node_resolve *r) {
   struct _run_on_resolve_ctx *ctx = r->user_data;
   ctx->r = r;
-  struct node *nn = node_find_direct_child(r->n, NODE_TYPE_BAG, "consumes");
+  struct node *nn = node_find_direct_child(r->n, NODE_TYPE_BAG, NODE_KW_CONSUMES);
 
   if (ctx->fe) {
     ctx->fe->value = 0;
@@ -328,35 +326,56 @@ static void _run_build(struct node *n) {
     .node_val_deps = { .usize = sizeof(struct node*) },
   };
 
-  r.force_outdated = n->post_build != 0
-                     || node_find_direct_child(n, NODE_TYPE_VALUE, "always") != 0;
+  r.force_outdated = n->ops->post_build != 0
+                     || node_find_direct_child(n, NODE_TYPE_VALUE, NODE_KW_ALWAYS) != 0;
 
+  bool fe_deps = false;
   for (struct node *nn = n->child; nn; nn = nn->next) {
-    if (strcmp(nn->value, "exec") == 0 || strcmp(nn->value, "shell") == 0) {
+    if (nn->kw == NODE_KW_EXEC || nn->kw == NODE_KW_SHELL) {
       for (struct node *cn = nn->child; cn; cn = cn->next) {
         if (node_is_value_may_be_dep_saved(cn, 0)) {
           ulist_push(&r.node_val_deps, &cn);
+        } else if (ctx.fe && node_is_can_be_value(cn)) {
+          // Loop variable dependent value is saved as evaluated with unset loop variable,
+          // so it still tracks other variables it reads. Loop items are saved below.
+          ulist_push(&r.node_val_deps, &cn);
+          fe_deps = true;
         }
       }
     }
   }
+  if (fe_deps) {
+    struct node *fn = node_find_parent_of_type(n, NODE_TYPE_FOREACH);
+    if (fn && fn->child && fn->child->next) {
+      ulist_push(&r.node_val_deps, &fn->child->next);
+    }
+  }
+  node_add_io_val_deps(n, &r.node_val_deps);
 
   node_resolve(&r);
   ulist_destroy_keep(&ctx.consumes);
   ulist_destroy_keep(&ctx.consumes_foreach);
 }
 
+static const struct node_ops _run_ops = {
+  .setup = _run_setup,
+  .build = _run_build,
+};
+
+static const struct node_ops _run_on_install_ops = {
+  .setup      = _run_setup,
+  .post_build = _run_build,
+};
+
 int node_run_setup(struct node *n) {
-  if (strcmp("run-on-install", n->value) == 0) {
+  if (n->kw == NODE_KW_RUN_ON_INSTALL) {
     if (g_env.install.enabled) {
       n->flags |= NODE_FLG_IN_CACHE;
-      n->setup = _run_setup;
-      n->post_build = _run_build;
+      n->ops = &_run_on_install_ops;
     }
   } else {
     n->flags |= NODE_FLG_IN_CACHE;
-    n->setup = _run_setup;
-    n->build = _run_build;
+    n->ops = &_run_ops;
   }
   return 0;
 }
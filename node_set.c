@@ -4,27 +4,28 @@
 #include "utils.h"
 #include "alloc.h"
 #include "env.h"
+#include "manifest.h"
 #endif
 
 static const char* _set_value_get(struct node *n);
 
 static void _set_dispose(struct node *n) {
   if ((uintptr_t) n->impl != (uintptr_t) -1) {
-    free(n->impl);
+    vlist_release(n->impl);
   }
   n->impl = 0;
 }
 
 static bool _set_is_let(struct node *n) {
-  return strcmp(n->value, "let") == 0;
+  return n->kw == NODE_KW_LET;
 }
 
 static struct unit* _unit_for_set(struct node *n, struct node *nn, const char **keyp) {
   if (nn->type == NODE_TYPE_BAG) {
-    if (strcmp(nn->value, "root") == 0) {
+    if (nn->kw == NODE_KW_ROOT) {
       *keyp = node_value(nn->child);
       return unit_root();
-    } else if (strcmp(nn->value, "parent") == 0) {
+    } else if (nn->kw == NODE_KW_PARENT) {
       *keyp = node_value(nn->child);
       return unit_parent(n);
     }
@@ -57,7 +58,7 @@ static void _set_setup(struct node *n) {
   if (_set_is_let(n)) {
     _set_init_impl(n);
   }
-  if (n->child && strcmp(n->value, "env") == 0) {
+  if (n->child && n->kw == NODE_KW_ENV) {
     const char *v = _set_value_get(n);
     if (v) {
       const char *key = 0;
@@ -66,7 +67,9 @@ static void _set_setup(struct node *n) {
         if (g_env.verbose) {
           node_info(n, "%s=%s", key, v);
         }
+        manifest_env(key);
         setenv(key, v, 1);
+        ++g_env.env_gen;
       }
     }
   }
@@ -78,16 +81,16 @@ static void _set_build(struct node *n) {
   }
 }
 
-static const char* _set_value_get(struct node *n) {
+static struct vlist* _set_list(struct node *n) {
   if (n->recur_next.active && n->recur_next.n) {
-    return _set_value_get(n->recur_next.n);
+    return _set_list(n->recur_next.n);
   }
   n->recur_next.active = true;
 
   struct node_foreach *fe = node_find_parent_foreach(n);
   if (fe || _set_is_let(n)) {
     if ((uintptr_t) n->impl != (uintptr_t) -1) {
-      free(n->impl);
+      vlist_release(n->impl);
     }
     n->impl = 0;
   }
@@ -102,47 +105,66 @@ static const char* _set_value_get(struct node *n) {
 
   n->impl = (void*) (uintptr_t) -1;
 
+  struct vlist *l = 0;
   struct node *nn = n->child->next;
   if (!nn) {
-    n->impl = xstrdup("");
-    n->recur_next.active = false;
-    return n->impl;
-  }
-
-  if (!nn->next && nn->value[0] != '.') { // Single value
-    const char *v = node_value(nn);
-    n->impl = xstrdup(v);
-    n->recur_next.active = false;
-    return n->impl;
-  }
-
-  struct xstr *xstr = xstr_create_empty();
-  for ( ; nn; nn = nn->next) {
-    const char *v = node_value(nn);
-    if (!v) {
-      v = "";
-    }
-    if (nn->value[0] == '.' && nn->value[1] == '.') {
-      utils_split_values_add(v, xstr);
-    } else {
-      if (!is_vlist(v)) {
-        xstr_cat(xstr, "\1");
+    l = vlist_create_scalar("");
+  } else if (!nn->next && nn->value[0] != '.') { // Single value
+    const struct vlist *v = node_list(nn);
+    l = v ? vlist_retain(v) : vlist_create_scalar("");
+  } else {
+    for ( ; nn; nn = nn->next) {
+      const struct vlist *v = node_list(nn);
+      bool spread = nn->value[0] == '.' && nn->value[1] == '.';
+      if (!v) {
+        continue;
+      } else if (!vlist_is_list(v)) {
+        if (!l) {
+          l = vlist_create();
+        }
+        if (spread) {
+          vlist_add_split(l, vlist_str(v));
+        } else {
+          const char *sv = vlist_str(v);
+          vlist_add(l, sv, strlen(sv));
+        }
+      } else if (!l) {
+        // Share list storage of the first list value
+        l = vlist_create_from(v);
+      } else {
+        vlist_add_list(l, v);
       }
-      xstr_cat(xstr, v);
+    }
+    if (!l) {
+      l = vlist_create();
     }
   }
 
-  n->impl = xstr_destroy_keep_ptr(xstr);
+  n->impl = l;
   n->recur_next.active = false;
   return n->impl;
 }
 
+static const char* _set_value_get(struct node *n) {
+  const struct vlist *l = _set_list(n);
+  return l ? vlist_str(l) : 0;
+}
+
+static struct vlist* _set_list_get(struct node *n) {
+  return vlist_retain(_set_list(n));
+}
+
+static const struct node_ops _set_ops = {
+  .value_get = _set_value_get,
+  .list_get  = _set_list_get,
+  .init      = _set_init,
+  .setup     = _set_setup,
+  .build     = _set_build,
+  .dispose   = _set_dispose,
+};
+
 int node_set_setup(struct node *n) {
   n->flags |= NODE_FLG_NO_CWD;
-  n->init = _set_init;
-  n->setup = _set_setup;
-  n->build = _set_build;
-  n->value_get = _set_value_get;
-  n->dispose = _set_dispose;
+  n->ops = &_set_ops;
   return 0;
 }
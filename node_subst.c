@@ -4,6 +4,8 @@
 #include "spawn.h"
 #include "xstr.h"
 #include "utils.h"
+#include "env.h"
+#include "manifest.h"
 
 #include <stdlib.h>
 #endif
@@ -23,6 +25,17 @@ static const char* _subst_setval(struct node *n, const char *vv, const char *dv)
   }
 }
 
+// Looks up variable substituted by the node: foreach loop variable or variable visible from the node.
+static bool _subst_lookup(struct node *n, const char *key, bool list, struct node_env_ref *out) {
+  struct node_foreach *fe = node_find_parent_foreach(n);
+  if (fe && strcmp(fe->name, key) == 0) {
+    ++fe->access_cnt;
+    *out = (struct node_env_ref) { .val = fe->value };
+    return true;
+  }
+  return node_env_lookup(n, key, list, out);
+}
+
 static const char* _subst_value(struct node *n) {
   if (n->child) {
     const char *dv_ = node_value(n->child->next);
@@ -36,18 +49,31 @@ static const char* _subst_value(struct node *n) {
       return _subst_setval(n, 0, dv);
     }
 
-    struct node_foreach *fe = node_find_parent_foreach(n);
-    if (fe && strcmp(fe->name, key) == 0) {
-      ++fe->access_cnt;
-      return _subst_setval(n, fe->value, dv);
-    }
-
-    const char *vv = node_env_get(n, key);
-    return _subst_setval(n, vv, dv);
+    struct node_env_ref ref;
+    _subst_lookup(n, key, false, &ref);
+    return _subst_setval(n, ref.val, dv);
   }
   return "";
 }
 
+static struct vlist* _subst_list(struct node *n) {
+  if (!n->child) {
+    return vlist_create_scalar("");
+  }
+  const char *key = node_value(n->child);
+  if (!key) {
+    node_warn(n, "No key specified");
+  } else {
+    struct node_env_ref ref;
+    if (_subst_lookup(n, key, true, &ref)) {
+      // List of the node holding the value is shared
+      return ref.list ? vlist_retain(ref.list) : vlist_create_from_str(ref.val);
+    }
+  }
+  const struct vlist *dl = node_list(n->child->next);
+  return dl ? vlist_retain(dl) : vlist_create_scalar("");
+}
+
 static void _subst_dispose(struct node *n) {
   if (n->impl) {
     free(n->impl);
@@ -106,6 +132,7 @@ static const char* _subst_value_proc(struct node *n) {
     val[i] = '\0';
   }
   n->impl = val;
+  manifest_proc(s, val);
   spawn_destroy(s);
   return n->impl;
 }
@@ -130,8 +157,15 @@ static void _subst_value_proc_cache_on_resolve(struct node_resolve *r) {
   if (rc) {
     node_fatal(rc, n, "Failed to open dependency file: %s", r->deps_path_tmp);
   }
-  node_add_unit_deps(n, &deps);
   deps_add(&deps, DEPS_TYPE_FILE, 0, path, 0);
+
+  for (int i = 0; i < r->node_val_deps.num; ++i) {
+    struct node *nv = *(struct node**) ulist_get(&r->node_val_deps, i);
+    const char *val = node_value(nv);
+    if (val) {
+      deps_add(&deps, DEPS_TYPE_NODE_VALUE, 0, val, i);
+    }
+  }
   deps_close(&deps);
 }
 
@@ -169,15 +203,31 @@ static const char* _subst_value_proc_cache(struct node *n) {
   return n->impl;
 }
 
+static const struct node_ops _subst_ops = {
+  .value_get  = _subst_value,
+  .list_get   = _subst_list,
+  .dispose    = _subst_dispose,
+  .value_memo = true,
+};
+
+static const struct node_ops _subst_proc_ops = {
+  .value_get = _subst_value_proc,
+  .dispose   = _subst_dispose,
+};
+
+static const struct node_ops _subst_proc_cache_ops = {
+  .value_get = _subst_value_proc_cache,
+  .dispose   = _subst_dispose,
+};
+
 int node_subst_setup(struct node *n) {
   if (strstr(n->value, "@@")) {
-    n->value_get = _subst_value_proc_cache;
+    n->ops = &_subst_proc_cache_ops;
   } else if (strchr(n->value, '@')) {
-    n->value_get = _subst_value_proc;
+    n->ops = &_subst_proc_ops;
   } else {
     n->flags |= NODE_FLG_NO_CWD;
-    n->value_get = _subst_value;
+    n->ops = &_subst_ops;
   }
-  n->dispose = _subst_dispose;
   return 0;
 }
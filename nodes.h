@@ -29,10 +29,15 @@ int node_find_setup(struct node*);
 int node_macro_setup(struct node*);
 int node_call_setup(struct node*);
 int node_fetch_url_setup(struct node*);
+int node_alias_setup(struct node*);
+int node_archive_setup(struct node*);
 
 struct node* call_macro_node(struct node*);
 struct node* call_first_node(struct node*);
 void macro_register_call(struct node*);
 void macro_unregister_call(struct node*);
 
+/// Executes check script declared with `provides {...}` if it was not executed yet.
+void node_check_provide(struct node*);
+
 #endif
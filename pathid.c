@@ -0,0 +1,177 @@
+#ifndef _AMALGAMATE_
+#include "pathid.h"
+#include "env.h"
+#include "log.h"
+#include "map.h"
+#include "ulist.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <string.h>
+#endif
+
+static inline struct pathid_entry* _pathid_entry(uint32_t id) {
+  if (id == 0 || id > g_env.pathids.entries.num) {
+    return 0;
+  }
+  return ulist_get(&g_env.pathids.entries, id - 1);
+}
+
+void pathid_init(void) {
+  if (!g_env.pathids.map) {
+    g_env.pathids.entries.usize = sizeof(struct pathid_entry);
+    g_env.pathids.map = map_create_str(0);
+    g_env.pathids.stat_gen = 1;
+  }
+}
+
+void pathid_dispose(void) {
+  map_destroy(g_env.pathids.map);
+  ulist_destroy_keep(&g_env.pathids.entries);
+  memset(&g_env.pathids, 0, sizeof(g_env.pathids));
+}
+
+uint32_t pathid_find_normalized(const char *path) {
+  if (!path || !g_env.pathids.map) {
+    return 0;
+  }
+  return (uint32_t) (uintptr_t) map_get(g_env.pathids.map, path);
+}
+
+uint32_t pathid_find(const char *path) {
+  char buf[PATH_MAX];
+  if (!path) {
+    return 0;
+  }
+  return pathid_find_normalized(path_normalize(path, buf));
+}
+
+uint32_t pathid_intern_normalized(const char *path) {
+  akassert(path && g_env.pathids.map);
+  uint32_t id = (uint32_t) (uintptr_t) map_get(g_env.pathids.map, path);
+  if (id) {
+    return id;
+  }
+
+  uint32_t parent = 0;
+  const char *sp = strrchr(path, '/');
+  if (sp && sp[1] != '\0') {
+    if (sp == path) {
+      parent = pathid_intern_normalized("/");
+    } else {
+      char buf[PATH_MAX];
+      size_t len = sp - path;
+      if (len >= sizeof(buf)) {
+        akfatal(ENAMETOOLONG, "%s", path);
+      }
+      memcpy(buf, path, len);
+      buf[len] = '\0';
+      parent = pathid_intern_normalized(buf);
+    }
+  }
+
+  struct pathid_entry e = { .parent = parent };
+  e.len = strlen(path);
+  e.hash = (uint32_t) utils_hash64(path, e.len);
+  e.path = pool_strndup(g_env.pool, path, e.len);
+
+  ulist_push(&g_env.pathids.entries, &e);
+  id = g_env.pathids.entries.num;
+  map_put_str_no_copy(g_env.pathids.map, e.path, (void*) (uintptr_t) id);
+  return id;
+}
+
+uint32_t pathid_intern(const char *path) {
+  char buf[PATH_MAX];
+  const char *p = path_normalize(path, buf);
+  if (!p) {
+    akfatal(errno, "Failed to normalize path: %s", path);
+  }
+  return pathid_intern_normalized(p);
+}
+
+const struct pathid_entry* pathid_entry(uint32_t id) {
+  return _pathid_entry(id);
+}
+
+const char* pathid_path(uint32_t id) {
+  struct pathid_entry *e = _pathid_entry(id);
+  return e ? e->path : 0;
+}
+
+uint32_t pathid_parent(uint32_t id) {
+  struct pathid_entry *e = _pathid_entry(id);
+  return e ? e->parent : 0;
+}
+
+uint32_t pathid_hash(uint32_t id) {
+  struct pathid_entry *e = _pathid_entry(id);
+  return e ? e->hash : 0;
+}
+
+int pathid_stat(uint32_t id, struct akpath_stat *st) {
+  struct pathid_entry *e = _pathid_entry(id);
+  if (!e) {
+    return EINVAL;
+  }
+  if ((e->flags & PATHID_FLG_STAT) && e->stat_gen == g_env.pathids.stat_gen) {
+    *st = e->stat;
+    return 0;
+  }
+  int rc = path_stat(e->path, st);
+  if (!rc) {
+    e->stat = *st;
+    e->stat_gen = g_env.pathids.stat_gen;
+    e->flags |= PATHID_FLG_STAT;
+  } else {
+    e->flags &= ~PATHID_FLG_STAT;
+  }
+  return rc;
+}
+
+int pathid_stat_fresh(uint32_t id, struct akpath_stat *st) {
+  struct pathid_entry *e = _pathid_entry(id);
+  if (!e) {
+    return EINVAL;
+  }
+  e->flags &= ~PATHID_FLG_STAT;
+  return pathid_stat(id, st);
+}
+
+bool pathid_is_exist(const char *path) {
+  struct akpath_stat st;
+  if (pathid_stat_fresh(pathid_intern(path), &st)) {
+    return false;
+  }
+  return st.ftype != AKPATH_NOT_EXISTS;
+}
+
+bool pathid_is_file(const char *path) {
+  struct akpath_stat st;
+  if (pathid_stat_fresh(pathid_intern(path), &st)) {
+    return false;
+  }
+  return st.ftype == AKPATH_TYPE_FILE;
+}
+
+void pathid_stat_reset(void) {
+  ++g_env.pathids.stat_gen;
+}
+
+int pathid_mkdirs(uint32_t id) {
+  struct pathid_entry *e = _pathid_entry(id);
+  if (!e) {
+    return EINVAL;
+  }
+  if (e->flags & PATHID_FLG_MKDIRS) {
+    return 0;
+  }
+  int rc = path_mkdirs(e->path);
+  if (rc) {
+    return rc;
+  }
+  for ( ; e && !(e->flags & PATHID_FLG_MKDIRS); e = _pathid_entry(e->parent)) {
+    e->flags |= PATHID_FLG_MKDIRS;
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef PATHID_H
+#define PATHID_H
+
+#ifndef _AMALGAMATE_
+#include "paths.h"
+
+#include <stdint.h>
+#endif
+
+/// Project wide table of interned paths.
+/// Every normalized absolute path is mapped to the stable 32-bit identifier
+/// valid for the whole autark session. Zero identifier means no path.
+/// Identifiers are not persistent, so paths stored in `.deps` files and other
+/// state files are kept as strings and interned when they are read.
+
+#define PATHID_FLG_STAT    0x01U // Stat info is cached for path
+#define PATHID_FLG_MKDIRS  0x02U // Directory was created by pathid_mkdirs()
+
+struct pathid_entry {
+  const char *path;        // Normalized absolute path.
+  uint32_t    parent;      // Parent directory path id. Zero for the `/` path.
+  uint32_t    hash;        // Precomputed path hash.
+  uint32_t    len;         // Path length.
+  uint32_t    stat_gen;    // Stat cache generation.
+  unsigned    flags;       // PATHID_FLG_XXX
+  struct akpath_stat stat; // Cached stat
+};
+
+void pathid_init(void);
+
+void pathid_dispose(void);
+
+/// Normalize the given path and return its interned id.
+uint32_t pathid_intern(const char *path);
+
+/// Returns interned id of path already normalized by path_normalize().
+uint32_t pathid_intern_normalized(const char *path);
+
+/// Normalize the given path and return its interned id or zero if path is not interned.
+uint32_t pathid_find(const char *path);
+
+/// Returns interned id of normalized path or zero if path is not interned.
+uint32_t pathid_find_normalized(const char *path);
+
+const struct pathid_entry* pathid_entry(uint32_t id);
+
+const char* pathid_path(uint32_t id);
+
+uint32_t pathid_parent(uint32_t id);
+
+uint32_t pathid_hash(uint32_t id);
+
+/// Stat the path using session stat cache.
+int pathid_stat(uint32_t id, struct akpath_stat *st);
+
+/// Stat the path bypassing session stat cache, the cached stat is updated.
+int pathid_stat_fresh(uint32_t id, struct akpath_stat *st);
+
+/// Checks if the path exists. Unlike path_is_exist() the probe is remembered
+/// in the stat cache, so missing paths are tracked by the build manifest as well.
+bool pathid_is_exist(const char *path);
+
+/// Checks if the path is a regular file, the probe is remembered like pathid_is_exist() does.
+bool pathid_is_file(const char *path);
+
+/// Invalidate all cached stat entries.
+/// Should be called when file system may be changed by external process.
+void pathid_stat_reset(void);
+
+/// Creates directory with all its parents, directories created during session are remembered.
+int pathid_mkdirs(uint32_t id);
+
+#endif
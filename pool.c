@@ -3,6 +3,7 @@
 #include "pool.h"
 #include "utils.h"
 #include "alloc.h"
+#include "log.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -10,15 +11,43 @@
 
 #define _UNIT_ALIGN_SIZE 8UL
 
+#define _FREELIST_MAX       16
+#define _FREELIST_UNIT_MAX  65536UL
+#define _SCRATCH_SIZE       65536UL
+
+#ifdef __GNUC__
+#define _TLS __thread
+#else
+#define _TLS
+#endif
+
+// Destroyed pools are kept with their last heap unit for reuse
+static _TLS struct pool *_freelist[_FREELIST_MAX];
+static _TLS int _freelist_num;
+static _TLS struct pool *_scratch;
+
 static void _extend(struct pool *pool, size_t siz);
 
+static void _units_free(struct pool_unit *u) {
+  for (struct pool_unit *next; u; u = next) {
+    next = u->next;
+    free(u->heap);
+    free(u);
+  }
+}
+
 struct pool* pool_create_empty(void) {
+  if (_freelist_num > 0) {
+    return _freelist[--_freelist_num];
+  }
   return xcalloc(1, sizeof(struct pool));
 }
 
 struct pool* pool_create_preallocated(size_t sz) {
   struct pool *pool = pool_create_empty();
-  _extend(pool, sz);
+  if (pool->asiz < sz) {
+    _extend(pool, sz);
+  }
   return pool;
 }
 
@@ -35,18 +64,69 @@ void pool_destroy(struct pool *pool) {
   if (pool->on_pool_destroy) {
     pool->on_pool_destroy(pool);
   }
-  for (struct pool_unit *u = pool->unit, *next; u; u = next) {
-    next = u->next;
+  struct pool_unit *u = pool->unit;
+  if (_freelist_num < _FREELIST_MAX && u && u->size <= _FREELIST_UNIT_MAX) {
+    _units_free(u->next);
+    u->next = 0;
+    memset(pool, 0, sizeof(*pool));
+    pool->unit = u;
+    pool->heap = u->heap;
+    pool->asiz = u->size;
+    _freelist[_freelist_num++] = pool;
+    return;
+  }
+  _units_free(u);
+  free(pool);
+}
+
+struct pool_mark pool_mark(struct pool *pool) {
+  return (struct pool_mark) {
+           .unit = pool->unit,
+           .heap = pool->heap,
+           .usiz = pool->usiz,
+           .asiz = pool->asiz
+  };
+}
+
+void pool_rewind(struct pool *pool, const struct pool_mark *m) {
+  while (pool->unit != m->unit) {
+    struct pool_unit *u = pool->unit;
+    akassert(u);
+    pool->unit = u->next;
     free(u->heap);
     free(u);
   }
-  free(pool);
+  pool->heap = m->heap;
+  pool->usiz = m->usiz;
+  pool->asiz = m->asiz;
+}
+
+struct pool* pool_scratch(void) {
+  if (!_scratch) {
+    _scratch = xcalloc(1, sizeof(*_scratch));
+    _extend(_scratch, _SCRATCH_SIZE);
+  }
+  return _scratch;
+}
+
+AK_DESTRUCTOR static void _pool_freelist_dispose(void) {
+  for (int i = 0; i < _freelist_num; ++i) {
+    _units_free(_freelist[i]->unit);
+    free(_freelist[i]);
+  }
+  _freelist_num = 0;
+  if (_scratch) {
+    _units_free(_scratch->unit);
+    free(_scratch);
+    _scratch = 0;
+  }
 }
 
 static void _extend(struct pool *pool, size_t siz) {
   struct pool_unit *nunit = xmalloc(sizeof(*nunit));
   siz = ROUNDUP(siz, _UNIT_ALIGN_SIZE);
   nunit->heap = xmalloc(siz);
+  nunit->size = siz;
   nunit->next = pool->unit;
   pool->heap = nunit->heap;
   pool->unit = nunit;
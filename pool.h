@@ -8,6 +8,7 @@
 
 struct  pool_unit {
   void *heap;
+  size_t size;
   struct pool_unit *next;
 };
 
@@ -20,6 +21,14 @@ struct pool {
   void  (*on_pool_destroy)(struct pool*); /// Called when pool destroyed
 };
 
+/// Saved pool allocation position, see pool_mark() and pool_rewind().
+struct pool_mark {
+  struct pool_unit *unit;
+  char  *heap;
+  size_t usiz;
+  size_t asiz;
+};
+
 struct pool* pool_create_empty(void);
 
 struct pool* pool_create_preallocated(size_t);
@@ -28,6 +37,16 @@ struct pool* pool_create(void (*)(struct pool*));
 
 void pool_destroy(struct pool*);
 
+/// Returns current allocation position of the pool.
+struct pool_mark pool_mark(struct pool*);
+
+/// Releases all pool memory allocated after the given mark.
+/// Marks must be rewound in LIFO order.
+void pool_rewind(struct pool*, const struct pool_mark*);
+
+/// Per thread scratch pool for short lived allocations scoped by pool_mark()/pool_rewind().
+struct pool* pool_scratch(void);
+
 void* pool_alloc(struct pool*, size_t siz);
 
 void* pool_calloc(struct pool*, size_t siz);
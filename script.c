@@ -38,14 +38,37 @@ static void _xparse_destroy(struct xparse *xp) {
 }
 
 static int _input(struct _yycontext *yy, char *buf, int max_size) {
+  // Feeds parser by whole lines, lines started with `#` are skipped
+  // but their line terminators are kept in order to preserve line numbers.
   struct xparse *xp = yy->x->xp;
+  const char *sp = (const char*) xp->val.buf + xp->pos;
+  const char *ep = (const char*) xp->val.buf + xp->val.len;
   int cnt = 0;
-  while (cnt < max_size && xp->pos < xp->val.len) {
-    char ch = *((char*) xp->val.buf + xp->pos);
-    *(buf + cnt) = ch;
-    ++xp->pos;
-    ++cnt;
+  while (cnt < max_size && sp < ep) {
+    if (xp->bol) {
+      const char *p = sp;
+      while (p < ep && *p != '\n' && utils_char_is_space(*p)) {
+        ++p;
+      }
+      if (p < ep && *p == '#') {
+        p = memchr(p, '\n', ep - p);
+        sp = p ? p : ep;
+      }
+      xp->bol = false;
+      continue;
+    }
+    const char *lp = memchr(sp, '\n', ep - sp);
+    size_t len = lp ? lp - sp + 1 : ep - sp;
+    if (len > max_size - cnt) {
+      len = max_size - cnt;
+    } else if (lp) {
+      xp->bol = true;
+    }
+    memcpy(buf + cnt, sp, len);
+    sp += len;
+    cnt += len;
   }
+  xp->pos = sp - (const char*) xp->val.buf;
   return cnt;
 }
 
@@ -54,14 +77,125 @@ static void _xnode_destroy(struct xnode *x) {
   if (n->unit && n->unit->n == n) {
     n->unit->n = 0;
   }
-  if (x->base.dispose) {
-    x->base.dispose(n);
+  if (n->ops && n->ops->dispose) {
+    n->ops->dispose(n);
   }
+  vlist_release(n->value_list);
+  n->value_list = 0;
   _xparse_destroy(x->xp);
   x->xp = 0;
 }
 
-static unsigned _rule_type(const char *key, unsigned *flags) {
+#define KW_MATCH(name__, kw__)                                      \
+        if (len == sizeof(name__) - 1 && !memcmp(key, name__, len)) { \
+          return kw__;                                                \
+        }
+
+// Resolves script keyword by its first character and length.
+// Keep cases in sync with enum node_kw when adding a keyword.
+static unsigned _kw_lookup(const char *key) {
+  size_t len = strlen(key);
+  switch (key[0]) {
+    case '$':
+      KW_MATCH("$", NODE_KW_SUBST);
+      break;
+    case '%':
+      KW_MATCH("%", NODE_KW_BASENAME);
+      break;
+    case '@':
+      KW_MATCH("@", NODE_KW_PROC);
+      KW_MATCH("@@", NODE_KW_PROC_CACHE);
+      break;
+    case 'C':
+      KW_MATCH("C", NODE_KW_DIR_C);
+      KW_MATCH("CC", NODE_KW_DIR_CC);
+      break;
+    case 'S':
+      KW_MATCH("S", NODE_KW_DIR_S);
+      KW_MATCH("SS", NODE_KW_DIR_SS);
+      break;
+    case '^':
+      KW_MATCH("^", NODE_KW_JOIN);
+      break;
+    case 'a':
+      KW_MATCH("alias", NODE_KW_ALIAS);
+      KW_MATCH("always", NODE_KW_ALWAYS);
+      KW_MATCH("archive", NODE_KW_ARCHIVE);
+      break;
+    case 'b':
+      KW_MATCH("batch", NODE_KW_BATCH);
+      KW_MATCH("build", NODE_KW_BUILD);
+      break;
+    case 'c':
+      KW_MATCH("cc", NODE_KW_CC);
+      KW_MATCH("cxx", NODE_KW_CXX);
+      KW_MATCH("call", NODE_KW_CALL);
+      KW_MATCH("check", NODE_KW_CHECK);
+      KW_MATCH("consumes", NODE_KW_CONSUMES);
+      KW_MATCH("configure", NODE_KW_CONFIGURE);
+      break;
+    case 'e':
+      KW_MATCH("env", NODE_KW_ENV);
+      KW_MATCH("echo", NODE_KW_ECHO);
+      KW_MATCH("else", NODE_KW_ELSE);
+      KW_MATCH("exec", NODE_KW_EXEC);
+      KW_MATCH("error", NODE_KW_ERROR);
+      break;
+    case 'f':
+      KW_MATCH("foreach", NODE_KW_FOREACH);
+      KW_MATCH("fetch-url", NODE_KW_FETCH_URL);
+      break;
+    case 'i':
+      KW_MATCH("if", NODE_KW_IF);
+      KW_MATCH("init", NODE_KW_INIT);
+      KW_MATCH("include", NODE_KW_INCLUDE);
+      KW_MATCH("install", NODE_KW_INSTALL);
+      KW_MATCH("in-sources", NODE_KW_IN_SOURCES);
+      KW_MATCH("install-sources", NODE_KW_INSTALL_SOURCES);
+      break;
+    case 'l':
+      KW_MATCH("let", NODE_KW_LET);
+      KW_MATCH("library", NODE_KW_LIBRARY);
+      break;
+    case 'm':
+      KW_MATCH("meta", NODE_KW_META);
+      KW_MATCH("macro", NODE_KW_MACRO);
+      KW_MATCH("modules", NODE_KW_MODULES);
+      break;
+    case 'o':
+      KW_MATCH("option", NODE_KW_OPTION);
+      KW_MATCH("objects", NODE_KW_OBJECTS);
+      break;
+    case 'p':
+      KW_MATCH("pch", NODE_KW_PCH);
+      KW_MATCH("parent", NODE_KW_PARENT);
+      KW_MATCH("produces", NODE_KW_PRODUCES);
+      KW_MATCH("provides", NODE_KW_PROVIDES);
+      break;
+    case 'r':
+      KW_MATCH("run", NODE_KW_RUN);
+      KW_MATCH("root", NODE_KW_ROOT);
+      KW_MATCH("run-on-install", NODE_KW_RUN_ON_INSTALL);
+      break;
+    case 's':
+      KW_MATCH("set", NODE_KW_SET);
+      KW_MATCH("setup", NODE_KW_SETUP);
+      KW_MATCH("shell", NODE_KW_SHELL);
+      break;
+    case 't':
+      KW_MATCH("thin-archive", NODE_KW_THIN_ARCHIVE);
+      break;
+    case 'u':
+      KW_MATCH("unity", NODE_KW_UNITY);
+      break;
+  }
+  return NODE_KW_NONE;
+}
+
+#undef KW_MATCH
+
+static unsigned _rule_type(struct node *n, unsigned *flags) {
+  const char *key = n->value;
   *flags = 0;
   if (key[0] == '.' && key[1] == '.') {
     key += 2;
@@ -70,55 +204,70 @@ static unsigned _rule_type(const char *key, unsigned *flags) {
     *flags = NODE_FLG_NEGATE;
     key += 1;
   }
-  if (strcmp(key, "$") == 0 || strcmp(key, "@") == 0 || strcmp(key, "@@") == 0) {
-    return NODE_TYPE_SUBST;
-  } else if (strcmp(key, "^") == 0) {
-    return NODE_TYPE_JOIN;
-  } else if (strcmp(key, "set") == 0 || strcmp(key, "env") == 0 || strcmp(key, "let") == 0) {
-    return NODE_TYPE_SET;
-  } else if (strcmp(key, "check") == 0) {
-    return NODE_TYPE_CHECK;
-  } else if (strcmp(key, "include") == 0) {
-    return NODE_TYPE_INCLUDE;
-  } else if (strcmp(key, "if") == 0) {
-    return NODE_TYPE_IF;
-  } else if (strcmp(key, "run") == 0 || strcmp(key, "run-on-install") == 0) {
-    return NODE_TYPE_RUN;
-  } else if (strcmp(key, "meta") == 0) {
-    return NODE_TYPE_META;
-  } else if (strcmp(key, "cc") == 0 || strcmp(key, "cxx") == 0) {
-    return NODE_TYPE_CC;
-  } else if (strcmp(key, "configure") == 0) {
-    return NODE_TYPE_CONFIGURE;
-  } else if (strcmp(key, "%") == 0) {
-    return NODE_TYPE_BASENAME;
-  } else if (strcmp(key, "foreach") == 0) {
-    return NODE_TYPE_FOREACH;
-  } else if (strcmp(key, "in-sources") == 0) {
-    return NODE_TYPE_IN_SOURCES;
-  } else if (  strcmp(key, "S") == 0 || strcmp(key, "C") == 0
-            || strcmp(key, "SS") == 0 || strcmp(key, "CC") == 0) {
-    return NODE_TYPE_DIR;
-  } else if (strcmp(key, "option") == 0) {
-    return NODE_TYPE_OPTION;
-  } else if (strcmp(key, "error") == 0) {
-    return NODE_TYPE_ERROR;
-  } else if (strcmp(key, "echo") == 0) {
-    return NODE_TYPE_ECHO;
-  } else if (strcmp(key, "install") == 0) {
-    return NODE_TYPE_INSTALL;
-  } else if (strcmp(key, "library") == 0) {
-    return NODE_TYPE_FIND;
-  } else if (strcmp(key, "macro") == 0) {
-    return NODE_TYPE_MACRO;
-  } else if (strcmp(key, "call") == 0) {
-    return NODE_TYPE_CALL;
-  } else if (strcmp(key, "install-sources") == 0) {
-    return NODE_TYPE_INSTALL_SOURCES;
-  } else if (strcmp(key, "fetch-url") == 0) {
-    return NODE_TYPE_FETCH_URL;
-  } else {
-    return NODE_TYPE_BAG;
+  // Keyword of prefixed key selects rule type only, node keeps keyword of its full key
+  unsigned kw = key != n->value ? _kw_lookup(key) : n->kw;
+  switch (kw) {
+    case NODE_KW_SUBST:
+    case NODE_KW_PROC:
+    case NODE_KW_PROC_CACHE:
+      return NODE_TYPE_SUBST;
+    case NODE_KW_JOIN:
+      return NODE_TYPE_JOIN;
+    case NODE_KW_SET:
+    case NODE_KW_ENV:
+    case NODE_KW_LET:
+      return NODE_TYPE_SET;
+    case NODE_KW_CHECK:
+      return NODE_TYPE_CHECK;
+    case NODE_KW_INCLUDE:
+      return NODE_TYPE_INCLUDE;
+    case NODE_KW_IF:
+      return NODE_TYPE_IF;
+    case NODE_KW_RUN:
+    case NODE_KW_RUN_ON_INSTALL:
+      return NODE_TYPE_RUN;
+    case NODE_KW_META:
+      return NODE_TYPE_META;
+    case NODE_KW_CC:
+    case NODE_KW_CXX:
+      return NODE_TYPE_CC;
+    case NODE_KW_CONFIGURE:
+      return NODE_TYPE_CONFIGURE;
+    case NODE_KW_BASENAME:
+      return NODE_TYPE_BASENAME;
+    case NODE_KW_FOREACH:
+      return NODE_TYPE_FOREACH;
+    case NODE_KW_IN_SOURCES:
+      return NODE_TYPE_IN_SOURCES;
+    case NODE_KW_DIR_S:
+    case NODE_KW_DIR_C:
+    case NODE_KW_DIR_SS:
+    case NODE_KW_DIR_CC:
+      return NODE_TYPE_DIR;
+    case NODE_KW_OPTION:
+      return NODE_TYPE_OPTION;
+    case NODE_KW_ERROR:
+      return NODE_TYPE_ERROR;
+    case NODE_KW_ECHO:
+      return NODE_TYPE_ECHO;
+    case NODE_KW_INSTALL:
+      return NODE_TYPE_INSTALL;
+    case NODE_KW_LIBRARY:
+      return NODE_TYPE_FIND;
+    case NODE_KW_MACRO:
+      return NODE_TYPE_MACRO;
+    case NODE_KW_CALL:
+      return NODE_TYPE_CALL;
+    case NODE_KW_INSTALL_SOURCES:
+      return NODE_TYPE_INSTALL_SOURCES;
+    case NODE_KW_FETCH_URL:
+      return NODE_TYPE_FETCH_URL;
+    case NODE_KW_ALIAS:
+      return NODE_TYPE_ALIAS;
+    case NODE_KW_ARCHIVE:
+      return NODE_TYPE_ARCHIVE;
+    default:
+      return NODE_TYPE_BAG;
   }
 }
 
@@ -188,7 +337,10 @@ int node_error(int rc, struct node *n, const char *fmt, ...) {
   return rc;
 }
 
+const struct node_ops node_ops_none = { 0 };
+
 static void _node_register(struct sctx *p, struct xnode *x) {
+  x->base.ops = &node_ops_none;
   x->base.index = p->nodes.num;
   ulist_push(&p->nodes, &x);
 }
@@ -204,6 +356,7 @@ static struct xnode* _node_text(struct _yycontext *yy, const char *text) {
   struct sctx *ctx = XCTX(yy->x);
   struct xnode *x = pool_calloc(g_env.pool, sizeof(*x));
   x->base.value = pool_strdup(g_env.pool, text);
+  x->base.kw = _kw_lookup(text);
   x->base.ctx = ctx;
   x->base.type = NODE_TYPE_VALUE;
   x->base.lnum = yy->x->lnum + 1;
@@ -228,12 +381,10 @@ struct node* node_clone_and_register(struct node *n_) {
   x->base.next = 0;
   x->base.parent = 0;
   x->base.impl = 0;
-  x->base.value_get = 0;
-  x->base.init = 0;
-  x->base.setup = 0;
-  x->base.build = 0;
-  x->base.post_build = 0;
-  x->base.dispose = 0;
+  x->base.value_memo = 0;
+  x->base.value_gen = 0;
+  x->base.value_list = 0;
+  x->base.value_list_gen = 0;
   _node_register(ctx, x);
   return (struct node*) x;
 }
@@ -282,7 +433,7 @@ static struct xnode* _rule(struct _yycontext *yy, struct xnode *key) {
   struct xparse *xp = yy->x->xp;
   struct ulist *s = &xp->stack;
   unsigned flags = 0;
-  key->base.type = _rule_type(key->base.value, &flags);
+  key->base.type = _rule_type(&key->base, &flags);
   key->base.flags |= flags;
   while (s->num) {
     struct xnode *x = XNODE_PEEK(s);
@@ -332,41 +483,176 @@ int node_visit(struct node *n, int lvl, void *ctx, int (*visitor)(struct node*,
   return _node_visit(n, lvl, ctx, visitor);
 }
 
-static void _preprocess_script(struct value *v) {
-  const char *p = v->buf;
-  char *nv = xmalloc(v->len + 1), *w = nv;
-  bool comment = false, eol = true;
-  while (*p) {
-    if (*p == '\n') {
-      eol = true;
-      comment = false;
-    } else if (eol) {
-      const char *sp = p;
-      while (utils_char_is_space(*sp)) {
-        ++sp;
-      }
-      if (*sp == '#') {
-        comment = true;
-      }
-      eol = false;
-    }
-    if (!comment) {
-      *w++ = *p++;
-    } else {
-      p++;
+/// Binary AST cache.
+///
+/// Parsed script tree is stored in `<unit cache dir>/.<script name>.ast` as a flat array
+/// of node records in registration order followed by the blob of node values.
+/// Cache is valid when size, mtime and content hash of the script source are not changed.
+
+#define AST_CACHE_MAGIC   "AKAST\0\0\0"
+#define AST_CACHE_VERSION 1U
+
+struct _ast_src {
+  uint64_t size;
+  uint64_t mtime;
+  uint64_t hash;
+};
+
+struct _ast_header {
+  char     magic[8];
+  uint32_t version;
+  uint32_t kw_count;
+  struct _ast_src src;
+  uint32_t num_nodes;
+  int32_t  child;        // First child of the script node.
+  uint64_t strings_size;
+};
+
+struct _ast_rec {
+  uint32_t type;
+  uint32_t flags;
+  uint32_t kw;
+  uint32_t lnum;
+  int32_t  parent;       // Relative node indexes: 0 is the script node, -1 is no node.
+  int32_t  child;
+  int32_t  next;
+  uint32_t value_len;
+};
+
+static void _ast_cache_path(struct node *n, char buf[PATH_MAX]) {
+  struct unit *unit = n->unit;
+  snprintf(buf, PATH_MAX, "%s/.%s.ast", unit->cache_dir, unit->basename);
+}
+
+static inline int32_t _ast_rel(struct node *n, unsigned base) {
+  return n ? (int32_t) (n->index - base) : -1;
+}
+
+static void _ast_cache_save(struct xnode *x, const struct _ast_src *src) {
+  struct sctx *ctx = x->base.ctx;
+  unsigned base = x->base.index;
+  struct _ast_header h = {
+    .magic = AST_CACHE_MAGIC,
+    .version = AST_CACHE_VERSION,
+    .kw_count = NODE_KW_COUNT,
+    .src = *src,
+    .num_nodes = ctx->nodes.num - base - 1,
+    .child = _ast_rel(x->base.child, base),
+  };
+  struct xstr *xstr = xstr_create_empty();
+  struct xstr *strings = xstr_create_empty();
+  xstr_cat2(xstr, &h, sizeof(h));
+  for (unsigned i = base + 1; i < ctx->nodes.num; ++i) {
+    struct node *n = NODE_AT(&ctx->nodes, i);
+    size_t len = strlen(n->value);
+    struct _ast_rec r = {
+      .type = n->type,
+      .flags = n->flags,
+      .kw = n->kw,
+      .lnum = n->lnum,
+      .parent = _ast_rel(n->parent, base),
+      .child = _ast_rel(n->child, base),
+      .next = _ast_rel(n->next, base),
+      .value_len = len,
+    };
+    xstr_cat2(xstr, &r, sizeof(r));
+    xstr_cat2(strings, n->value, len + 1);
+  }
+  ((struct _ast_header*) xstr->ptr)->strings_size = strings->size;
+  xstr_cat2(xstr, strings->ptr, strings->size);
+
+  char path[PATH_MAX], tmp[PATH_MAX];
+  _ast_cache_path(&x->base, path);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  int rc = utils_file_write_buf(tmp, xstr->ptr, xstr->size, false);
+  if (!rc && rename(tmp, path) == -1) {
+    rc = errno;
+    unlink(tmp);
+  }
+  if (rc && g_env.verbose) {
+    akerror(rc, "Failed to write AST cache: %s", path);
+  }
+  xstr_destroy(strings);
+  xstr_destroy(xstr);
+}
+
+static bool _ast_cache_load(struct xnode *x, const struct _ast_src *src) {
+  char path[PATH_MAX];
+  _ast_cache_path(&x->base, path);
+  struct value v = utils_file_as_buf(path, -1);
+  if (v.error || v.len < sizeof(struct _ast_header)) {
+    value_destroy(&v);
+    return false;
+  }
+
+  bool ret = false;
+  struct _ast_header *h = v.buf;
+  struct _ast_rec *recs = (void*) (h + 1);
+  const char *strings = (void*) (recs + h->num_nodes);
+  int32_t num = h->num_nodes;
+
+  if (  memcmp(h->magic, AST_CACHE_MAGIC, sizeof(h->magic)) != 0
+     || h->version != AST_CACHE_VERSION
+     || h->kw_count != NODE_KW_COUNT
+     || memcmp(&h->src, src, sizeof(*src)) != 0
+     || num < 0
+     || v.len != sizeof(*h) + (uint64_t) num * sizeof(*recs) + h->strings_size
+     || h->child < -1 || h->child > num) {
+    goto finish;
+  }
+  for (uint64_t i = 0, off = 0; i < num; ++i) {
+    struct _ast_rec *r = &recs[i];
+    off += r->value_len + 1;
+    if (  r->parent < -1 || r->parent > num
+       || r->child < -1 || r->child > num
+       || r->next < -1 || r->next > num
+       || r->kw >= NODE_KW_COUNT
+       || off > h->strings_size
+       || strings[off - 1] != '\0') {
+      goto finish;
     }
   }
-  *w = '\0';
-  free(v->buf);
-  v->buf = nv;
-  v->len = w - nv;
+
+  // Single allocation for all nodes and their values
+  size_t nsz = num * sizeof(struct xnode);
+  char *block = pool_alloc(g_env.pool, nsz + h->strings_size);
+  struct xnode *xs = memset(block, 0, nsz);
+  char *sp = memcpy(block + nsz, strings, h->strings_size);
+
+#define AST_NODE(idx__) ((idx__) < 0 ? 0 : (idx__) == 0 ? &x->base : &xs[(idx__) - 1].base)
+
+  x->base.child = AST_NODE(h->child);
+  for (int32_t i = 0; i < num; ++i) {
+    struct _ast_rec *r = &recs[i];
+    struct node *n = &xs[i].base;
+    n->type = r->type;
+    n->flags = r->flags;
+    n->kw = r->kw;
+    n->lnum = r->lnum;
+    n->ctx = x->base.ctx;
+    n->value = sp;
+    n->parent = AST_NODE(r->parent);
+    n->child = AST_NODE(r->child);
+    n->next = AST_NODE(r->next);
+    sp += r->value_len + 1;
+    _node_register(n->ctx, &xs[i]);
+  }
+
+#undef AST_NODE
+
+  ret = true;
+
+finish:
+  value_destroy(&v);
+  return ret;
 }
 
 static int _script_from_value(
-  struct node  *parent,
-  const char   *file,
-  struct value *val,
-  struct node **out) {
+  struct node           *parent,
+  const char            *file,
+  struct value          *val,
+  const struct _ast_src *src,
+  struct node          **out) {
   int rc = 0;
 
   struct xnode *x = 0;
@@ -375,12 +661,12 @@ static int _script_from_value(
   char prevcwd_[PATH_MAX];
   char *prevcwd = 0;
 
-  _preprocess_script(val);
-
   if (!parent) {
     struct sctx *ctx = pool_calloc(pool, sizeof(*ctx));
     ulist_init(&ctx->nodes, 64, sizeof(struct node*));
-    ctx->products = map_create_str(map_k_free);
+    ctx->products = map_create_u32(0);
+    ctx->aliases = map_create_str(map_k_free);
+    ctx->vfiles = map_create_u64(0);
 
     x = pool_calloc(pool, sizeof(*x));
     x->base.ctx = ctx;
@@ -414,11 +700,16 @@ static int _script_from_value(
   _node_register(x->base.ctx, x);
   _node_bind(&x->base);
 
+  if (src && _ast_cache_load(x, src)) {
+    goto finish;
+  }
+
   x->xp = xmalloc(sizeof(*x->xp));
   *x->xp = (struct xparse) {
     .stack = { .usize = sizeof(struct xnode*) },
     .xerr = xstr_create_empty(),
     .val = *val,
+    .bol = true,
   };
 
   yycontext *yy = x->xp->yy = xmalloc(sizeof(yycontext));
@@ -426,6 +717,11 @@ static int _script_from_value(
     .x = x
   };
 
+  struct timespec t0, t1;
+  if (g_env.verbose) {
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+  }
+
   if (!yyparse(yy)) {
     rc = AK_ERROR_SCRIPT_SYNTAX;
     _yyerror(yy);
@@ -436,6 +732,15 @@ static int _script_from_value(
     }
     goto finish;
   }
+  if (g_env.verbose) {
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+    akinfo("%s: parsed %zu bytes in %.2fms, %.1f MB/s", x->base.value, val->len, ms,
+           ms > 0 ? val->len / (ms * 1e3) : 0.0);
+  }
+  if (src) {
+    _ast_cache_save(x, src);
+  }
 
 finish:
   _xparse_destroy(x->xp);
@@ -453,13 +758,37 @@ finish:
 
 static int _script_from_file(struct node *parent, const char *file, struct node **out) {
   *out = 0;
-  struct value buf = utils_file_as_buf(file, (1024 * 1024));
-  if (buf.error) {
-    return value_destroy(&buf);
+  struct akpath_stat st;
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return errno;
   }
-  int ret = _script_from_value(parent, file, &buf, out);
-  value_destroy(&buf);
-  return ret;
+  int rc = path_stat_fd(fd, &st);
+  if (rc) {
+    close(fd);
+    return rc;
+  }
+  struct value buf = { .len = st.size };
+  if (buf.len) {
+    buf.buf = mmap(0, buf.len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buf.buf == MAP_FAILED) {
+      rc = errno;
+      close(fd);
+      return rc;
+    }
+  }
+  close(fd);
+
+  struct _ast_src src = {
+    .size = buf.len,
+    .mtime = st.mtime,
+    .hash = utils_hash64(buf.buf, buf.len),
+  };
+  rc = _script_from_value(parent, file, &buf, &src, out);
+  if (buf.len) {
+    munmap(buf.buf, buf.len);
+  }
+  return rc;
 }
 
 static void _script_destroy(struct sctx *s) {
@@ -469,10 +798,45 @@ static void _script_destroy(struct sctx *s) {
       _xnode_destroy(x);
     }
     map_destroy(s->products);
+    map_destroy(s->aliases);
+    map_destroy(s->vfiles);
     ulist_destroy_keep(&s->nodes);
   }
 }
 
+// Appends normalized node content: types, values and structure without line numbers.
+static void _node_content_append(struct node *n, struct xstr *xstr) {
+  xstr_printf(xstr, "%u:%s", n->type, n->value ? n->value : "");
+  if (n->child) {
+    xstr_cat2(xstr, "{", 1);
+    for (struct node *nn = n->child; nn; nn = nn->next) {
+      _node_content_append(nn, xstr);
+      xstr_cat2(xstr, "\1", 1);
+    }
+    xstr_cat2(xstr, "}", 1);
+  }
+}
+
+// Node state file name derived from the script path and node content,
+// so it stays the same when unrelated parts of the script are changed.
+static const char* _node_vfile(struct node *n) {
+  struct sctx *s = n->ctx;
+  struct xstr *xstr = xstr_create_empty();
+  xstr_printf(xstr, "%s\1", _node_file(n));
+  _node_content_append(n, xstr);
+  uint64_t hash = utils_hash64(xstr_ptr(xstr), xstr_size(xstr));
+  xstr_destroy(xstr);
+
+  // Nodes with the same content are distinguished by their order
+  unsigned cnt = (unsigned) (uintptr_t) map_get_u64(s->vfiles, hash);
+  map_put_u64(s->vfiles, hash, (void*) (uintptr_t) (cnt + 1));
+  if (cnt) {
+    return pool_printf(g_env.pool, ".%016" PRIx64 "-%u", hash, cnt);
+  } else {
+    return pool_printf(g_env.pool, ".%016" PRIx64, hash);
+  }
+}
+
 static int _node_bind(struct node *n) {
   int rc = 0;
   if (!(n->flags & NODE_FLG_BOUND)) {
@@ -484,7 +848,7 @@ static int _node_bind(struct node *n) {
     } else {
       n->name = pool_printf(g_env.pool, "%s     %5s", _node_file(n), "");
     }
-    n->vfile = pool_printf(g_env.pool, ".%u", n->index);
+    n->vfile = _node_vfile(n);
 
     switch (n->type) {
       case NODE_TYPE_SCRIPT:
@@ -557,6 +921,17 @@ static int _node_bind(struct node *n) {
       case NODE_TYPE_FETCH_URL:
         rc = node_fetch_url_setup(n);
         break;
+      case NODE_TYPE_ALIAS:
+        rc = node_alias_setup(n);
+        break;
+      case NODE_TYPE_ARCHIVE:
+        rc = node_archive_setup(n);
+        break;
+    }
+
+    // Values computed inside foreach depend on the current loop item
+    if (n->ops->value_memo && !node_find_parent_of_type(n, NODE_TYPE_FOREACH)) {
+      n->flags |= NODE_FLG_VALUE_MEMO;
     }
 
     switch (n->type) {
@@ -596,10 +971,17 @@ static void _node_context_pop(struct node *n) {
 const char* node_value(struct node *n) {
   if (n) {
     node_setup(n);
-    if (n->value_get) {
+    if (n->ops->value_get) {
+      if (n->value_memo && n->value_gen == g_env.env_gen) {
+        return n->value_memo;
+      }
       _node_context_push(n);
-      const char *ret = n->value_get(n);
+      const char *ret = n->ops->value_get(n);
       _node_context_pop(n);
+      if (n->flags & NODE_FLG_VALUE_MEMO) {
+        n->value_memo = ret;
+        n->value_gen = g_env.env_gen;
+      }
       return ret;
     } else {
       return n->value;
@@ -609,6 +991,35 @@ const char* node_value(struct node *n) {
   }
 }
 
+const struct vlist* node_list(struct node *n) {
+  if (!n) {
+    return 0;
+  }
+  node_setup(n);
+  if (n->value_list) {
+    if (!n->ops->value_get) {
+      return n->value_list;
+    } else if ((n->flags & NODE_FLG_VALUE_MEMO) && n->value_list_gen == g_env.env_gen) {
+      return n->value_list;
+    }
+  }
+  struct vlist *l = 0;
+  if (n->ops->list_get) {
+    _node_context_push(n);
+    l = n->ops->list_get(n);
+    _node_context_pop(n);
+  } else {
+    const char *v = node_value(n);
+    if (v) {
+      l = vlist_create_from_str(v);
+    }
+  }
+  vlist_release(n->value_list);
+  n->value_list = l;
+  n->value_list_gen = g_env.env_gen;
+  return l;
+}
+
 void node_reset(struct node *n) {
   n->flags &= ~(NODE_FLG_BUILT | NODE_FLG_SETUP | NODE_FLG_INIT);
 }
@@ -655,7 +1066,9 @@ void node_init(struct node *n) {
       case NODE_TYPE_MACRO:
       case NODE_TYPE_CALL:
         _node_context_push(n);
-        n->init(n);
+        if (n->ops->init) {
+          n->ops->init(n);
+        }
         if (n->type == NODE_TYPE_CALL) {
           struct node *cn = n->next;
           struct node *mn = call_macro_node(n);
@@ -670,11 +1083,11 @@ void node_init(struct node *n) {
         _node_context_pop(n);
         break;
       default:
-        if (n->init || n->child) {
+        if (n->ops->init || n->child) {
           _node_context_push(n);
           _init_subnodes(n);
-          if (n->init) {
-            n->init(n);
+          if (n->ops->init) {
+            n->ops->init(n);
           }
           _node_context_pop(n);
         }
@@ -686,17 +1099,17 @@ void node_setup(struct node *n) {
   if (!node_is_setup(n)) {
     n->flags |= NODE_FLG_SETUP;
     if (n->type != NODE_TYPE_FOREACH) {
-      if (n->child || n->setup) {
+      if (n->child || n->ops->setup) {
         _node_context_push(n);
         _setup_subnodes(n);
-        if (n->setup) {
-          n->setup(n);
+        if (n->ops->setup) {
+          n->ops->setup(n);
         }
         _node_context_pop(n);
       }
     } else {
       _node_context_push(n);
-      n->setup(n);
+      n->ops->setup(n);
       _setup_subnodes(n);
       _node_context_pop(n);
     }
@@ -706,7 +1119,7 @@ void node_setup(struct node *n) {
 void node_build(struct node *n) {
   if (!node_is_built(n)) {
     _build_subnodes(n);
-    if (n->build) {
+    if (n->ops->build) {
       if (g_env.verbose) {
         node_info(n, "Build");
       }
@@ -716,7 +1129,7 @@ void node_build(struct node *n) {
         node_fatal(AK_ERROR_CYCLIC_BUILD_DEPS, n, 0);
       }
       _node_context_push(n);
-      n->build(n);
+      n->ops->build(n);
       _node_context_pop(n);
       x->bld_calls--;
     }
@@ -727,7 +1140,7 @@ void node_build(struct node *n) {
 void node_post_build(struct node *n) {
   if (!node_is_post_built(n)) {
     _post_build_subnodes(n);
-    if (n->post_build) {
+    if (n->ops->post_build) {
       if (g_env.verbose) {
         node_info(n, "Post-build");
       }
@@ -737,7 +1150,7 @@ void node_post_build(struct node *n) {
         node_fatal(AK_ERROR_CYCLIC_BUILD_DEPS, n, 0);
       }
       _node_context_push(n);
-      n->post_build(n);
+      n->ops->post_build(n);
       _node_context_pop(n);
       x->bld_calls--;
     }
@@ -821,6 +1234,82 @@ void script_build(struct sctx *s) {
   node_post_build(s->root);
 }
 
+static struct node* _target_product_find(struct sctx *s, const char *target) {
+  char buf[PATH_MAX];
+  const char *dirs[] = { g_env.project.cache_dir, g_env.project.root_dir, g_env.cwd };
+  for (int i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+    if (dirs[i] && path_normalize_cwd(target, dirs[i], buf)) {
+      uint32_t id = pathid_find_normalized(buf);
+      struct node *n = id ? map_get_u32(s->products, id) : 0;
+      if (n) {
+        return n;
+      }
+    }
+  }
+
+  // Unique product path suffix
+  struct map_iter it;
+  struct node *found = 0;
+  const char *found_path = 0;
+  size_t len = strlen(target);
+  map_iter_init(s->products, &it);
+  while (map_iter_next(&it)) {
+    const char *path = pathid_path((uint32_t) (uintptr_t) it.key);
+    size_t plen = strlen(path);
+    if (plen > len && path[plen - len - 1] == '/' && strcmp(path + plen - len, target) == 0) {
+      if (found && found != it.val) {
+        akfatal(AK_ERROR_FAIL, "Ambiguous target: '%s' matches both %s and %s", target, found_path, path);
+      }
+      found = (struct node*) it.val;
+      found_path = path;
+    }
+  }
+  return found;
+}
+
+static void _target_resolve(struct sctx *s, const char *target, struct ulist *nodes, int depth) {
+  struct node *n = map_get(s->aliases, target);
+  if (n) {
+    if (depth > 32) {
+      node_fatal(AK_ERROR_CYCLIC_BUILD_DEPS, n, "Alias: %s", target);
+    }
+    for (struct node *nn = n->child ? n->child->next : 0; nn; nn = nn->next) {
+      const struct vlist *l = node_list(nn);
+      for (size_t i = 0; l && i < l->num; ++i) {
+        const struct vlist_item *item = vlist_item(l, i);
+        if (item->len) {
+          char buf[item->len + 1];
+          memcpy(buf, item->ptr, item->len + 1);
+          _target_resolve(s, buf, nodes, depth + 1);
+        }
+      }
+    }
+    return;
+  }
+  n = _target_product_find(s, target);
+  if (!n) {
+    akfatal(AK_ERROR_FAIL, "Unknown build target: %s", target);
+  }
+  ulist_push(nodes, &n);
+}
+
+void script_build_targets(struct sctx *s, const struct ulist *targets) {
+  akassert(s->root);
+  struct ulist nodes = { .usize = sizeof(struct node*) };
+  node_init(s->root);
+  node_setup(s->root);
+  for (int i = 0; i < targets->num; ++i) {
+    _target_resolve(s, *(char**) ulist_get(targets, i), &nodes, 0);
+  }
+  for (int i = 0; i < nodes.num; ++i) {
+    node_build(*(struct node**) ulist_get(&nodes, i));
+  }
+  for (int i = 0; i < nodes.num; ++i) {
+    node_post_build(*(struct node**) ulist_get(&nodes, i));
+  }
+  ulist_destroy_keep(&nodes);
+}
+
 void script_close(struct sctx **sp) {
   if (sp && *sp) {
     _script_destroy(*sp);
@@ -861,17 +1350,36 @@ void script_dump(struct sctx *p, struct xstr *xstr) {
   _node_visit(p->root, 1, &ctx, _node_dump_visitor);
 }
 
-const char* node_env_get(struct node *n, const char *key) {
-  const char *ret = 0;
+bool node_env_lookup(struct node *n, const char *key, bool list, struct node_env_ref *out) {
+  struct unit *prev = 0;
+  *out = (struct node_env_ref) { 0 };
   for ( ; n; n = n->parent) {
-    if (n->unit) {
-      ret = unit_env_get_raw(n->unit, key);
-      if (ret) {
-        return ret;
+    if (n->unit && n->unit != prev) {
+      prev = n->unit;
+      struct unit_env_item *item = unit_env_item(n->unit, key);
+      if (!item) {
+        continue;
+      }
+      if (item->val) {
+        out->val = item->val;
+      } else if (list) {
+        out->list = node_list(item->n);
+      } else {
+        out->val = node_value(item->n);
+      }
+      if (out->val || out->list) {
+        return true;
       }
     }
   }
-  return getenv(key);
+  out->val = manifest_getenv(key);
+  return out->val != 0;
+}
+
+const char* node_env_get(struct node *n, const char *key) {
+  struct node_env_ref ref;
+  node_env_lookup(n, key, false, &ref);
+  return ref.val;
 }
 
 void node_env_set(struct node *n, const char *key, const char *val) {
@@ -932,21 +1440,20 @@ void node_product_add(struct node *n, const char *prod, char pathbuf[PATH_MAX])
 }
 
 void node_product_add_raw(struct node *n, const char *prod) {
-  char buf[PATH_MAX];
   struct sctx *s = n->ctx;
-  struct node *nn = map_get(s->products, prod);
+  uint32_t id = pathid_intern_normalized(prod);
+  struct node *nn = map_get_u32(s->products, id);
   if (nn) {
     if (nn == n) {
       return;
     }
     node_fatal(AK_ERROR_FAIL, n, "Product: '%s' was registered by other rule: %s", prod, nn->name);
   }
-  utils_strncpy(buf, prod, sizeof(buf));
-  char *dir = path_dirname(buf);
+  uint32_t dir = pathid_parent(id);
   if (dir) {
-    path_mkdirs(dir);
+    pathid_mkdirs(dir);
   }
-  map_put_str(s->products, prod, n);
+  map_put_u32(s->products, id, n);
 }
 
 struct node* node_by_product(struct node *n, const char *prod, char pathbuf[PATH_MAX]) {
@@ -959,13 +1466,14 @@ struct node* node_by_product(struct node *n, const char *prod, char pathbuf[PATH
   if (!prod) {
     node_fatal(errno, n, 0);
   }
-  struct node *nn = map_get(s->products, prod);
-  return nn;
+  uint32_t id = pathid_find_normalized(prod);
+  return id ? map_get_u32(s->products, id) : 0;
 }
 
 struct node* node_by_product_raw(struct node *n, const char *prod) {
   struct sctx *s = n->ctx;
-  return map_get(s->products, prod);
+  uint32_t id = pathid_find_normalized(prod);
+  return id ? map_get_u32(s->products, id) : 0;
 }
 
 void node_products_add_as_deps(struct node *n, struct deps *deps) {
@@ -975,16 +1483,16 @@ void node_products_add_as_deps(struct node *n, struct deps *deps) {
   int64_t ts = utils_current_time_ms();
   while (map_iter_next(&it)) {
     if (it.val == n) {
-      deps_add(deps, DEPS_TYPE_FILE, 0, it.key, ts);
+      deps_add(deps, DEPS_TYPE_FILE, 0, pathid_path((uint32_t) (uintptr_t) it.key), ts);
     }
   }
 }
 
-struct node* node_find_direct_child(struct node *n, int type, const char *val) {
+struct node* node_find_direct_child(struct node *n, int type, unsigned kw) {
   if (n) {
     for (struct node *nn = n->child; nn; nn = nn->next) {
       if (type == 0 || nn->type == type) {
-        if (val == 0 || strcmp(nn->value, val) == 0) {
+        if (kw == NODE_KW_NONE || nn->kw == kw) {
           return nn;
         }
       }
@@ -1057,16 +1565,14 @@ struct node* node_consumes_resolve(
 
   if (nn || paths) {
     for ( ; nn; nn = nn->next) {
-      const char *cv = node_value(nn);
-      if (is_vlist(cv)) {
-        struct vlist_iter iter;
-        vlist_iter_init(cv, &iter);
-        while (vlist_iter_next(&iter)) {
-          cv = pool_strndup(pool, iter.item, iter.len);
+      const struct vlist *l = node_list(nn);
+      for (size_t i = 0; l && i < l->num; ++i) {
+        const struct vlist_item *item = vlist_item(l, i);
+        if (item->len) {
+          // Node lists may be recomputed while building products
+          const char *cv = pool_strndup(pool, item->ptr, item->len);
           ulist_push(&rlist, &cv);
         }
-      } else if (cv && *cv != '\0') {
-        ulist_push(&rlist, &cv);
       }
     }
 
@@ -1087,7 +1593,7 @@ struct node* node_consumes_resolve(
         if (pn) {
           node_build(pn);
         }
-        if (path_is_exist(pathbuf)) {
+        if (pathid_is_exist(pathbuf)) {
           if (on_resolved) {
             on_resolved(pathbuf, opq);
           }
@@ -1102,7 +1608,7 @@ struct node* node_consumes_resolve(
       for (int i = 0; i < rlist.num; ++i) {
         const char *cv = *(char**) ulist_get(&rlist, i);
         akassert(path_normalize(cv, pathbuf));
-        if (path_is_exist(pathbuf)) {
+        if (pathid_is_exist(pathbuf)) {
           if (on_resolved) {
             on_resolved(pathbuf, opq);
           }
@@ -1119,12 +1625,14 @@ struct node* node_consumes_resolve(
   return nn;
 }
 
-void node_add_unit_deps(struct node *n, struct deps *deps) {
-  struct unit *prev = 0;
-  for (struct node *nn = n; nn; nn = nn->parent) {
-    if (nn->unit && nn->unit != prev) {
-      prev = nn->unit;
-      deps_add(deps, DEPS_TYPE_FILE, 0, nn->unit->source_path, 0);
+void node_add_io_val_deps(struct node *n, struct ulist *node_val_deps) {
+  for (struct node *nn = n->child; nn; nn = nn->next) {
+    if (nn->type == NODE_TYPE_BAG && (nn->kw == NODE_KW_CONSUMES || nn->kw == NODE_KW_PRODUCES)) {
+      for (struct node *cn = nn->child; cn; cn = cn->next) {
+        if (node_is_value_may_be_dep_saved(cn, NODE_TYPE_VALUE)) {
+          ulist_push(node_val_deps, &cn);
+        }
+      }
     }
   }
 }
@@ -1134,7 +1642,8 @@ void node_resolve(struct node_resolve *r) {
 
   int rc;
   struct deps deps = { 0 };
-  struct pool *pool = pool_create_empty();
+  struct pool *pool = pool_scratch();
+  struct pool_mark mark = pool_mark(pool);
   struct unit *unit = unit_peek();
 
   const char *deps_path = pool_printf(pool, "%s/%s.deps", unit->cache_dir, r->path);
@@ -1203,12 +1712,17 @@ void node_resolve(struct node_resolve *r) {
       xstr_printf(g_env.check.log, "%s: resolved outdated outdated=%d\n", r->n->name, r->resolve_outdated.num);
     }
     r->on_resolve(r);
+    pathid_stat_reset();
     if (access(deps_path_tmp, F_OK) == 0) {
       rc = utils_rename_file(deps_path_tmp, deps_path);
       if (rc) {
         akfatal(rc, "Rename failed of %s to %s", deps_path_tmp, deps_path);
       }
     }
+    // Rule without saved dependencies is resolved again by the next build
+    if (r->force_outdated || access(deps_path, F_OK) != 0) {
+      ++g_env.manifest.forced;
+    }
     if (r->on_env_value && !access(env_path_tmp, F_OK)) {
       rc = utils_rename_file(env_path_tmp, env_path);
       if (rc) {
@@ -1241,7 +1755,7 @@ void node_resolve(struct node_resolve *r) {
 
   ulist_destroy_keep(&r->resolve_outdated);
   ulist_destroy_keep(&r->node_val_deps);
-  pool_destroy(pool);
+  pool_rewind(pool, &mark);
 }
 
 #ifdef TESTS
@@ -6,6 +6,7 @@
 #include "xstr.h"
 #include "deps.h"
 #include "map.h"
+#include "vlist.h"
 
 #include <stdbool.h>
 #endif
@@ -38,11 +39,72 @@
 #define NODE_TYPE_MACRO           0x800000U
 #define NODE_TYPE_CALL            0x1000000U
 #define NODE_TYPE_INSTALL_SOURCES 0x2000000U
+#define NODE_TYPE_ALIAS           0x4000000U
+#define NODE_TYPE_ARCHIVE         0x8000000U
+
+/// Script keywords resolved once at parse time, see node::kw
+enum node_kw {
+  NODE_KW_NONE = 0,
+  NODE_KW_SUBST,           // $
+  NODE_KW_PROC,            // @
+  NODE_KW_PROC_CACHE,      // @@
+  NODE_KW_JOIN,            // ^
+  NODE_KW_BASENAME,        // %
+  NODE_KW_SET,
+  NODE_KW_ENV,
+  NODE_KW_LET,
+  NODE_KW_CHECK,
+  NODE_KW_INCLUDE,
+  NODE_KW_IF,
+  NODE_KW_RUN,
+  NODE_KW_RUN_ON_INSTALL,
+  NODE_KW_META,
+  NODE_KW_CC,
+  NODE_KW_CXX,
+  NODE_KW_CONFIGURE,
+  NODE_KW_FOREACH,
+  NODE_KW_IN_SOURCES,
+  NODE_KW_DIR_S,           // S
+  NODE_KW_DIR_C,           // C
+  NODE_KW_DIR_SS,          // SS
+  NODE_KW_DIR_CC,          // CC
+  NODE_KW_OPTION,
+  NODE_KW_ERROR,
+  NODE_KW_ECHO,
+  NODE_KW_INSTALL,
+  NODE_KW_LIBRARY,
+  NODE_KW_MACRO,
+  NODE_KW_CALL,
+  NODE_KW_INSTALL_SOURCES,
+  NODE_KW_FETCH_URL,
+  NODE_KW_ALIAS,
+  NODE_KW_ARCHIVE,
+  // Rule options
+  NODE_KW_CONSUMES,
+  NODE_KW_PRODUCES,
+  NODE_KW_PROVIDES,
+  NODE_KW_OBJECTS,
+  NODE_KW_PCH,
+  NODE_KW_UNITY,
+  NODE_KW_BATCH,
+  NODE_KW_MODULES,
+  NODE_KW_THIN_ARCHIVE,
+  NODE_KW_EXEC,
+  NODE_KW_SHELL,
+  NODE_KW_ALWAYS,
+  NODE_KW_ELSE,
+  NODE_KW_ROOT,
+  NODE_KW_PARENT,
+  NODE_KW_INIT,
+  NODE_KW_SETUP,
+  NODE_KW_BUILD,
+  NODE_KW_COUNT,
+};
 
 #define NODE_FLG_BOUND 0x01U
 #define NODE_FLG_INIT  0x02U
 #define NODE_FLG_SETUP 0x04U
-// Vacant: 0x08U
+#define NODE_FLG_VALUE_MEMO           0x08U // Node value may be memoized
 #define NODE_FLG_BUILT                0x10U // Node built
 #define NODE_FLG_POST_BUILT           0x20U // Node post-built
 #define NODE_FLG_IN_CACHE             0x40U
@@ -71,12 +133,30 @@ struct node_foreach {
   unsigned access_cnt;
 };
 
+/// Node type specific operations shared by all nodes of the same type.
+struct node_ops {
+  const char* (*value_get)(struct node*);
+  struct vlist* (*list_get)(struct node*); /// Returns a new reference to the list form of node value.
+  void (*init)(struct node*);
+  void (*setup)(struct node*);
+  void (*build)(struct node*);
+  void (*post_build)(struct node*);
+  void (*dispose)(struct node*);
+  /// Result of value_get() depends only on node subtree and environment,
+  /// so it may be memoized until environment generation is changed.
+  bool value_memo;
+};
+
+/// Operations of nodes without any type specific behavior.
+extern const struct node_ops node_ops_none;
+
 struct node {
   unsigned type;
   unsigned flags;
   unsigned flags_owner; /// Extra flaghs set by owner node
   unsigned index;       /// Own index in env::nodes
   unsigned lnum;        /// Node line number
+  unsigned kw;          /// Keyword of node value (enum node_kw)
 
   const char *name;   /// Internal node name
   const char *vfile;  /// Node virtual file
@@ -95,12 +175,12 @@ struct node {
   struct sctx *ctx;
   struct unit *unit;
 
-  const char* (*value_get)(struct node*);
-  void (*init)(struct node*);
-  void (*setup)(struct node*);
-  void (*build)(struct node*);
-  void (*post_build)(struct node*);
-  void (*dispose)(struct node*);
+  const struct node_ops *ops; /// Node type operations, never zero
+
+  const char   *value_memo;     /// Memoized node value
+  unsigned      value_gen;      /// Environment generation of memoized value
+  struct vlist *value_list;     /// List form of node value
+  unsigned      value_list_gen; /// Environment generation of value list
 
   void *impl;
 };
@@ -108,7 +188,9 @@ struct node {
 struct sctx {
   struct node *root;     /// Project root script node (Autark)
   struct ulist nodes;    /// ulist<struct node*>
-  struct map  *products; /// Products of nodes  (product name -> node)
+  struct map  *products; /// Products of nodes  (product path id -> node)
+  struct map  *aliases;  /// Named build targets (alias name -> alias node)
+  struct map  *vfiles;   /// Node state files (content hash -> number of nodes with the same hash)
 };
 
 int script_open(const char *file, struct sctx **out);
@@ -117,10 +199,25 @@ int script_include(struct node *parent, const char *file, struct node **out);
 
 void script_build(struct sctx*);
 
+/// Builds only the given targets (struct ulist<char*>) and everything they consume.
+/// Target is either an alias name, a product path or a unique product path suffix.
+void script_build_targets(struct sctx*, const struct ulist *targets);
+
 void script_close(struct sctx**);
 
 void script_dump(struct sctx*, struct xstr *out);
 
+/// Variable visible from the node.
+struct node_env_ref {
+  const char *val;          // Value of variable
+  const struct vlist *list; // List value of node holding variable, set only if list is requested
+};
+
+/// Looks up variable in env of units enclosing the node, then in the process environment.
+/// Variable held by node is returned as node list if `list` is true, otherwise as node value.
+/// Variables held by nodes without value are skipped. Returns false if variable is not found.
+bool node_env_lookup(struct node*, const char *key, bool list, struct node_env_ref *out);
+
 const char* node_env_get(struct node*, const char *key);
 
 void node_env_set(struct node*, const char *key, const char *val);
@@ -141,6 +238,10 @@ void node_reset(struct node *n);
 
 const char* node_value(struct node *n);
 
+/// Returns node value as list or zero if node has no value. Returned list is owned by node
+/// and valid until the next evaluation of node value.
+const struct vlist* node_list(struct node *n);
+
 #define NODE_VISIT_CHILD_SKIP INT_MAX
 
 int node_visit(struct node *n, int lvl, void *ctx, int (*visitor)(struct node*, int, void*));
@@ -155,7 +256,7 @@ void node_build(struct node *n);
 
 void node_post_build(struct node *n);
 
-struct node* node_find_direct_child(struct node *n, int type, const char *val);
+struct node* node_find_direct_child(struct node *n, int type, unsigned kw);
 
 struct node* node_find_prev_sibling(struct node *n);
 
@@ -172,7 +273,9 @@ struct node* node_consumes_resolve(
   void (*on_resolved)(const char *path, void *opq),
   void *opq);
 
-void node_add_unit_deps(struct node *n, struct deps*);
+/// Adds evaluated items of `consumes` and `produces` sections of the rule
+/// to the list of node value dependencies (struct ulist<struct node*>).
+void node_add_io_val_deps(struct node *n, struct ulist *node_val_deps);
 
 struct node_resolve {
   struct node *n;
@@ -185,7 +288,7 @@ struct node_resolve {
   const char  *env_path_tmp;
   struct ulist resolve_outdated; // struct resolve_outdated
   struct ulist node_val_deps;    // struct node*
-  struct pool *pool;
+  struct pool *pool;             // Scratch pool, allocated memory is released when node_resolve() returns
   unsigned     mode;
   int  num_deps;    // Number of dependencies
   bool force_outdated;
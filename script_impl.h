@@ -9,11 +9,17 @@
 #include "nodes.h"
 #include "autark.h"
 #include "paths.h"
+#include "pathid.h"
+#include "manifest.h"
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 #endif
 
 #define XNODE(n__)              ((struct xnode*) (n__))
@@ -31,7 +37,8 @@ struct xparse {
   struct ulist       stack;   // ulist<struct xnode*>
   struct value       val;
   struct xstr       *xerr;
-  int pos;
+  size_t pos;
+  bool   bol;             // Input position is at the beginning of line
 };
 
 struct xnode {
@@ -6,9 +6,15 @@
 #include "xstr.h"
 #include "env.h"
 #include "utils.h"
+#include "pathid.h"
+#include "alloc.h"
+#include "map.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,13 +33,20 @@ struct spawn {
   struct ulist env;
   const char  *exec;
   char *path_overriden;
-  bool  nowait;
+  const char *stdin_file;
+  const char *stdout_file;
+  int   fds[2]; // Read ends of stdout and stderr pipes of running process
+  bool  silent; // Do not print command line
 
   size_t (*stdin_provider)(char *buf, size_t buflen, struct spawn*);
   void   (*stdout_handler)(char *buf, size_t buflen, struct spawn*);
   void   (*stderr_handler)(char *buf, size_t buflen, struct spawn*);
+  void   (*exit_handler)(struct spawn*);
 };
 
+// Processes started by spawn_start() (struct spawn*)
+static struct ulist _started = { .usize = sizeof(struct spawn*) };
+
 struct spawn* spawn_create(const char *exec, void *user_data) {
   akassert(exec);
   struct pool *pool = pool_create_empty();
@@ -41,6 +54,7 @@ struct spawn* spawn_create(const char *exec, void *user_data) {
   *s = (struct spawn) {
     .pool = pool,
     .pid = -1,
+    .fds = { -1, -1 },
     .args = {
       .usize = sizeof(char*)
     },
@@ -135,36 +149,104 @@ void spawn_env_path_prepend(struct spawn *s, const char *path) {
   s->path_overriden = xstr_destroy_keep_ptr(xstr);
 }
 
-static char* _file_resolve_in_path(struct spawn *s, const char *file, char pathbuf[PATH_MAX]) {
-  char buf[PATH_MAX];
-  const char *sp = s->path_overriden;
-  if (!sp) {
-    sp = getenv("PATH");
-  }
-  const char *ep = sp;
-  while (sp) {
+// Cache of resolved executables: `<PATH>\1<file>` -> path of file.
+static struct map *_path_cache;
+
+// Environment block shared by spawned processes without own environment variables.
+static struct {
+  struct pool *pool;
+  char **envp;     // Environment block of spawned processes
+  char **snapshot; // Process environment the block is created from
+  char  *path;     // PATH of the block, zero if PATH is not overriden
+  int    num;      // Number of process environment entries
+} _env_block;
+
+// Reads the next dir of `sp` PATH list into `buf`, returns zero at the end of list.
+static const char* _path_dir_next(const char *sp, char buf[PATH_MAX]) {
+  while (sp && *sp != '\0') {
+    const char *ep = sp;
     for ( ; *ep != '\0' && *ep != ':'; ++ep) ;
-    if (ep - sp > 0 && ep - sp < PATH_MAX) {
-      memcpy(buf, sp, ep - sp);
-      buf[ep - sp] = '\0';
-      if (buf[ep - sp - 1] != '/') {
-        snprintf(pathbuf, PATH_MAX, "%s/%s", buf, file);
-      } else {
-        snprintf(pathbuf, PATH_MAX, "%s%s", buf, file);
-      }
-      if (!access(pathbuf, F_OK)) {
-        return pathbuf;
-      }
-    }
+    size_t len = ep - sp;
     while (*ep == ':') ++ep;
-    if (*ep == '\0') {
-      break;
+    if (len > 0 && len < PATH_MAX) {
+      memcpy(buf, sp, len);
+      buf[len] = '\0';
+      return ep;
     }
     sp = ep;
   }
   return 0;
 }
 
+static void _path_file(const char *dir, const char *file, char pathbuf[PATH_MAX]) {
+  if (dir[strlen(dir) - 1] != '/') {
+    snprintf(pathbuf, PATH_MAX, "%s/%s", dir, file);
+  } else {
+    snprintf(pathbuf, PATH_MAX, "%s%s", dir, file);
+  }
+}
+
+static char* _file_resolve_in_path(const char *sp, const char *file, char pathbuf[PATH_MAX]) {
+  char buf[PATH_MAX];
+  while ((sp = _path_dir_next(sp, buf))) {
+    _path_file(buf, file, pathbuf);
+    if (!access(pathbuf, F_OK)) {
+      return pathbuf;
+    }
+  }
+  return 0;
+}
+
+// Checks the previously resolved file is still the first one found in PATH.
+// Only dirs located in the project cache dir, where build may place executables,
+// are checked before the resolved file dir.
+static bool _file_resolved_is_valid(const char *sp, const char *file, const char *resolved) {
+  char buf[PATH_MAX], pathbuf[PATH_MAX];
+  if (access(resolved, F_OK)) {
+    return false;
+  }
+  const char *cache_dir = g_env.project.cache_dir;
+  while ((sp = _path_dir_next(sp, buf))) {
+    _path_file(buf, file, pathbuf);
+    if (strcmp(pathbuf, resolved) == 0) {
+      return true;
+    }
+    if ((buf[0] != '/' || (cache_dir && utils_startswith(buf, cache_dir))) && !access(pathbuf, F_OK)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+static char* _file_resolve(struct spawn *s, const char *file, char pathbuf[PATH_MAX]) {
+  const char *sp = s->path_overriden;
+  if (!sp) {
+    sp = getenv("PATH");
+  }
+  if (!sp) {
+    return 0;
+  }
+  if (!_path_cache) {
+    _path_cache = map_create_str(map_kv_free);
+  }
+  struct xstr *xstr = xstr_create_empty();
+  xstr_printf(xstr, "%s\1%s", sp, file);
+  const char *resolved = map_get(_path_cache, xstr_ptr(xstr));
+  if (resolved && _file_resolved_is_valid(sp, file, resolved)) {
+    utils_strncpy(pathbuf, resolved, PATH_MAX);
+    xstr_destroy(xstr);
+    return pathbuf;
+  }
+  char *ret = _file_resolve_in_path(sp, file, pathbuf);
+  if (ret) {
+    map_put_str(_path_cache, xstr_ptr(xstr), xstrdup(ret));
+  } else if (resolved) {
+    map_remove(_path_cache, xstr_ptr(xstr));
+  }
+  xstr_destroy(xstr);
+  return ret;
+}
+
 static char* _env_find(struct spawn *s, const char *key, size_t keylen) {
   if (keylen == 0) {
     return 0;
@@ -179,31 +261,70 @@ static char* _env_find(struct spawn *s, const char *key, size_t keylen) {
   return 0;
 }
 
-static char** _env_create(struct spawn *s) {
-  int i = 0, c = 0;
-  if (s->path_overriden) {
-    spawn_env_set(s, "PATH", s->path_overriden);
+static bool _env_block_is_valid(const char *path) {
+  if (!_env_block.envp) {
+    return false;
+  }
+  if (path ? (!_env_block.path || strcmp(path, _env_block.path) != 0) : _env_block.path != 0) {
+    return false;
+  }
+  int i = 0;
+  for (char **ep = environ; *ep; ++ep, ++i) {
+    if (i >= _env_block.num || strcmp(*ep, _env_block.snapshot[i]) != 0) {
+      return false;
+    }
   }
+  return i == _env_block.num;
+}
 
+// Returns environment block for the given PATH, the block is rebuilt only when process environment is changed.
+static char** _env_block_get(const char *path) {
+  if (_env_block_is_valid(path)) {
+    return _env_block.envp;
+  }
+  if (_env_block.pool) {
+    pool_destroy(_env_block.pool);
+  }
+  struct pool *pool = pool_create_empty();
+  int c = 0, i = 0, j = 0;
   for (char **ep = environ; *ep; ++ep, ++c) ;
-  c += s->env.num;
 
-  char **nenv = pool_alloc(s->pool, sizeof(*nenv) * (c + 1));
-  nenv[c] = 0;
+  _env_block.pool = pool;
+  _env_block.num = c;
+  _env_block.path = path ? pool_strdup(pool, path) : 0;
+  _env_block.snapshot = pool_alloc(pool, sizeof(char*) * (c + 1));
+  _env_block.envp = pool_alloc(pool, sizeof(char*) * (c + 2));
 
-  for (char **it = environ; *it && i < c; ++it, ++i) {
-    const char *entry = *it;
-    const char *ep = strchr(entry, '=');
-    if (ep == 0) {
+  for (char **it = environ; *it; ++it, ++i) {
+    char *entry = pool_strdup(pool, *it);
+    _env_block.snapshot[i] = entry;
+    if (!strchr(entry, '=') || (path && utils_startswith(entry, "PATH="))) {
       continue;
     }
-    size_t keylen = ep - entry;
-    char *my = _env_find(s, entry, keylen);
-    if (my) {
-      nenv[i] = my;
-    } else {
-      nenv[i] = (char*) pool_strdup(s->pool, entry);
-    }
+    _env_block.envp[j++] = entry;
+  }
+  _env_block.snapshot[i] = 0;
+  if (path) {
+    _env_block.envp[j++] = (char*) pool_printf(pool, "PATH=%s", path);
+  }
+  _env_block.envp[j] = 0;
+  return _env_block.envp;
+}
+
+static char** _env_create(struct spawn *s) {
+  char **envp = _env_block_get(s->path_overriden);
+  if (!s->env.num) {
+    return envp;
+  }
+  int i = 0, c = 0;
+  for (char **ep = envp; *ep; ++ep, ++c) ;
+  c += s->env.num;
+
+  char **nenv = pool_alloc(s->pool, sizeof(*nenv) * (c + 1));
+  for (char **it = envp; *it; ++it, ++i) {
+    const char *entry = *it;
+    char *my = _env_find(s, entry, strchr(entry, '=') - entry);
+    nenv[i] = my ? my : (char*) entry;
   }
   for (c = 0; c < s->env.num; ++c, ++i) {
     nenv[i] = *(char**) ulist_get(&s->env, c);
@@ -212,6 +333,17 @@ static char** _env_create(struct spawn *s) {
   return nenv;
 }
 
+void spawn_dispose(void) {
+  if (_path_cache) {
+    map_destroy(_path_cache);
+    _path_cache = 0;
+  }
+  if (_env_block.pool) {
+    pool_destroy(_env_block.pool);
+  }
+  memset(&_env_block, 0, sizeof(_env_block));
+}
+
 static char** _args_create(struct spawn *s) {
   char **args = pool_alloc(s->pool, sizeof(*args) * (s->args.num + 1));
   for (int i = 0; i < s->args.num; ++i) {
@@ -263,17 +395,89 @@ void spawn_set_stderr_handler(
   s->stderr_handler = handler;
 }
 
-void spawn_set_nowait(struct spawn *s, bool nowait) {
-  s->nowait = nowait;
+void spawn_set_stdin_file(struct spawn *s, const char *path) {
+  s->stdin_file = pool_strdup(s->pool, path);
 }
 
-void spawn_set_wstatus(struct spawn *s, int wstatus) {
-  s->wstatus = wstatus;
+void spawn_set_stdout_file(struct spawn *s, const char *path) {
+  s->stdout_file = pool_strdup(s->pool, path);
 }
 
-int spawn_do(struct spawn *s) {
+// Pipe ends are not inherited by spawned processes except duplicated std descriptors.
+static int _spawn_pipe(int fds[2]) {
+  if (pipe(fds) == -1) {
+    return errno;
+  }
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return 0;
+}
+
+static void _spawn_pipe_close(int fds[2]) {
+  for (int i = 0; i < 2; ++i) {
+    if (fds[i] != -1) {
+      close(fds[i]);
+      fds[i] = -1;
+    }
+  }
+}
+
+// Self-pipe written by SIGCHLD handler, so poll() is woken up when any child process exits.
+static int _sigchld_fds[2] = { -1, -1 };
+static pid_t _sigchld_owner;
+
+static void _spawn_on_sigchld(int sig) {
+  int err = errno;
+  if (_sigchld_fds[1] != -1) {
+    ssize_t rc = write(_sigchld_fds[1], "", 1);
+    (void) rc;
+  }
+  errno = err;
+}
+
+static int _spawn_sigchld_init(void) {
+  pid_t pid = getpid();
+  if (_sigchld_owner == pid) {
+    return 0;
+  }
+  // Pipe inherited by forked process is shared with its parent
+  _spawn_pipe_close(_sigchld_fds);
+  int rc = _spawn_pipe(_sigchld_fds);
+  if (rc) {
+    return rc;
+  }
+  for (int i = 0; i < 2; ++i) {
+    fcntl(_sigchld_fds[i], F_SETFL, fcntl(_sigchld_fds[i], F_GETFL) | O_NONBLOCK);
+  }
+  struct sigaction sa = {
+    .sa_handler = _spawn_on_sigchld,
+    .sa_flags = SA_RESTART | SA_NOCLDSTOP,
+  };
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGCHLD, &sa, 0) == -1) {
+    rc = errno;
+    _spawn_pipe_close(_sigchld_fds);
+    return rc;
+  }
+  _sigchld_owner = pid;
+  return 0;
+}
+
+static void _spawn_sigchld_drain(void) {
+  char buf[64];
+  while (read(_sigchld_fds[0], buf, sizeof(buf)) > 0) ;
+}
+
+void spawn_set_exit_handler(struct spawn *s, void (*handler)(struct spawn*)) {
+  s->exit_handler = handler;
+}
+
+void spawn_set_silent(struct spawn *s, bool silent) {
+  s->silent = silent;
+}
+
+static int _spawn_launch(struct spawn *s) {
   int rc = 0;
-  bool nowait = s->nowait;
 
   if (!s->stderr_handler) {
     s->stderr_handler = _default_stderr_handler;
@@ -291,7 +495,10 @@ int spawn_do(struct spawn *s) {
   char **args = _args_create(s);
   const char *file = args[0];
 
-  {
+  // Spawned process may change any file
+  pathid_stat_reset();
+
+  if (!s->silent) {
     struct xstr *xstr = xstr_create_empty();
     for (char **a = args; *a; ++a) {
       if (a != args) {
@@ -308,7 +515,7 @@ int spawn_do(struct spawn *s) {
   ssize_t len;
 
   if (!strchr(file, '/')) {
-    const char *rfile = _file_resolve_in_path(s, file, pathbuf);
+    const char *rfile = _file_resolve(s, file, pathbuf);
     if (!rfile) {
       akerror(ENOENT, "Failed to find: '%s' in PATH", file);
       errno = ENOENT;
@@ -317,136 +524,235 @@ int spawn_do(struct spawn *s) {
     file = rfile;
   }
 
-  if (!nowait) {
-    if (pipe(pipe_stdout) == -1) {
-      return errno;
-    }
-    if (pipe(pipe_stderr) == -1) {
-      return errno;
-    }
+  if ((rc = _spawn_sigchld_init())) {
+    akerror(rc, "Failed to set SIGCHLD handler", 0);
+    return rc;
+  }
+
+  if ((rc = _spawn_pipe(pipe_stdout)) || (rc = _spawn_pipe(pipe_stderr))) {
+    _spawn_pipe_close(pipe_stdout);
+    return rc;
   }
 
   if (s->stdin_provider) {
-    if (pipe(pipe_stdin) == -1) {
-      return errno;
+    if ((rc = _spawn_pipe(pipe_stdin))) {
+      _spawn_pipe_close(pipe_stdout);
+      _spawn_pipe_close(pipe_stderr);
+      return rc;
     }
   }
 
-  s->pid = fork();
-  if (s->pid == -1) {
-    return errno;
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (pipe_stdin[0] != -1) {
+    posix_spawn_file_actions_adddup2(&actions, pipe_stdin[0], STDIN_FILENO);
+  }
+  posix_spawn_file_actions_adddup2(&actions, pipe_stdout[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, pipe_stderr[1], STDERR_FILENO);
+  if (s->stdin_file) {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, s->stdin_file, O_RDONLY, 0);
   }
+  if (s->stdout_file) {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, s->stdout_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+
+  rc = posix_spawn(&s->pid, file, &actions, 0, args, envp);
+  posix_spawn_file_actions_destroy(&actions);
 
-  if (s->pid == 0) {
-    if (pipe_stdin[0] != -1) {
-      close(pipe_stdin[1]);
-      if (dup2(pipe_stdin[0], STDIN_FILENO) == -1) {
-        perror("dup2");
-        _exit(EXIT_FAILURE);
+  if (rc) {
+    s->pid = -1;
+    _spawn_pipe_close(pipe_stdout);
+    _spawn_pipe_close(pipe_stderr);
+    _spawn_pipe_close(pipe_stdin);
+    akerror(rc, "Failed to spawn: %s", file);
+    return rc;
+  }
+
+  close(pipe_stdout[1]);
+  close(pipe_stderr[1]);
+  s->fds[0] = pipe_stdout[0];
+  s->fds[1] = pipe_stderr[0];
+
+  if (s->stdin_provider) {
+    close(pipe_stdin[0]);
+    ssize_t tow = 0;
+    while ((tow = s->stdin_provider(buf, sizeof(buf), s)) > 0) {
+      while (tow > 0) {
+        len = write(pipe_stdin[1], buf, tow);
+        if (len == -1 && errno == EAGAIN) {
+          continue;
+        }
+        if (len > 0) {
+          tow -= len;
+        } else {
+          break;
+        }
       }
-      close(pipe_stdin[0]);
     }
+    close(pipe_stdin[1]);
+  }
+  return 0;
+}
 
-    if (!nowait) {
-      close(pipe_stdout[0]);
-      if (dup2(pipe_stdout[1], STDOUT_FILENO) == -1) {
-        perror("dup2");
-        _exit(EXIT_FAILURE);
+// Dispatches output of process available on the given pipe, pipe is closed at the end of output.
+// Returns true if output was dispatched.
+static bool _spawn_read(struct spawn *s, int idx, short revents) {
+  char buf[1024];
+  if (revents & POLLIN) {
+    ssize_t n = read(s->fds[idx], buf, sizeof(buf) - 1);
+    if (n > 0) {
+      buf[n] = '\0';
+      if (idx == 0) {
+        s->stdout_handler(buf, n, s);
+      } else {
+        s->stderr_handler(buf, n, s);
       }
-      close(pipe_stdout[1]);
+      return true;
+    } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      return false;
+    }
+  } else if (!(revents & (POLLERR | POLLHUP | POLLNVAL))) {
+    return false;
+  }
+  close(s->fds[idx]);
+  s->fds[idx] = -1;
+  return false;
+}
 
-      close(pipe_stderr[0]);
-      if (dup2(pipe_stderr[1], STDERR_FILENO) == -1) {
-        perror("dup2");
-        _exit(EXIT_FAILURE);
-      }
-      close(pipe_stderr[1]);
+// Reads output left in pipes of finished process and closes them.
+// End of output is not awaited since pipes may be held open by background descendants of process.
+static void _spawn_drain(struct spawn *s) {
+  for (int i = 0; i < 2; ++i) {
+    if (s->fds[i] != -1) {
+      fcntl(s->fds[i], F_SETFL, fcntl(s->fds[i], F_GETFL) | O_NONBLOCK);
+      while (s->fds[i] != -1 && _spawn_read(s, i, POLLIN)) ;
     }
+  }
+  _spawn_pipe_close(s->fds);
+}
 
-    execve(file, args, envp);
+static void _spawn_reap(struct spawn *s) {
+  while (waitpid(s->pid, &s->wstatus, 0) == -1) {
+    if (errno != EINTR) {
+      perror("waitpid");
+      break;
+    }
+  }
+}
 
-    perror("execve");
-    _exit(EXIT_FAILURE);
-  } else {
-    if (!nowait) {
-      close(pipe_stdout[1]);
-      close(pipe_stderr[1]);
+// Checks without blocking if process is finished, finished process is reaped.
+static bool _spawn_exited(struct spawn *s) {
+  pid_t pid;
+  while ((pid = waitpid(s->pid, &s->wstatus, WNOHANG)) == -1) {
+    if (errno != EINTR) {
+      perror("waitpid");
+      return true;
     }
+  }
+  return pid == s->pid;
+}
 
-    if (s->stdin_provider) {
-      close(pipe_stdin[0]);
-      ssize_t tow = 0;
-      while ((tow = s->stdin_provider(buf, sizeof(buf), s)) > 0) {
-        while (tow > 0) {
-          len = write(pipe_stdin[1], buf, tow);
-          if (len == -1 && errno == EAGAIN) {
-            continue;
-          }
-          if (len > 0) {
-            tow -= len;
-          } else {
-            break;
-          }
-        }
+int spawn_do(struct spawn *s) {
+  int rc = _spawn_launch(s);
+  if (rc) {
+    return rc;
+  }
+  while (true) {
+    struct pollfd fds[] = {
+      { .fd = s->fds[0], .events = POLLIN },
+      { .fd = s->fds[1], .events = POLLIN },
+      { .fd = _sigchld_fds[0], .events = POLLIN }
+    };
+    if (poll(fds, sizeof(fds) / sizeof(fds[0]), -1) == -1 && errno != EINTR) {
+      _spawn_pipe_close(s->fds);
+      _spawn_reap(s);
+      break;
+    }
+    _spawn_sigchld_drain();
+    for (int i = 0; i < 2; ++i) {
+      if (fds[i].fd != -1) {
+        _spawn_read(s, i, fds[i].revents);
       }
-      close(pipe_stdin[1]);
     }
+    if (_spawn_exited(s)) {
+      _spawn_drain(s);
+      break;
+    }
+  }
+  return 0;
+}
 
-    if (!nowait) {
-      // Now read both stdout & stderr
-      struct pollfd fds[] = {
-        { .fd = pipe_stdout[0], .events = POLLIN },
-        { .fd = pipe_stderr[0], .events = POLLIN }
-      };
-
-      int c = sizeof(fds) / sizeof(fds[0]);
-      while (c > 0) {
-        int ret = poll(fds, sizeof(fds) / sizeof(fds[0]), -1);
-        if (ret == -1) {
-          break;
-        }
-        for (int i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
-          if (fds[i].fd == -1) {
-            continue;
-          }
-          short revents = fds[i].revents;
-          if (revents & POLLIN) {
-            ssize_t n = read(fds[i].fd, buf, sizeof(buf) - 1);
-            if (n > 0) {
-              buf[n] = '\0';
-              if (fds[i].fd == pipe_stdout[0]) {
-                s->stdout_handler(buf, n, s);
-              } else {
-                s->stderr_handler(buf, n, s);
-              }
-            } else if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
-              close(fds[i].fd);
-              fds[i].fd = -1;
-              --c;
-            }
-          }
-          if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
-            close(fds[i].fd);
-            fds[i].fd = -1;
-            --c;
-          }
+int spawn_start(struct spawn *s) {
+  int rc = _spawn_launch(s);
+  if (!rc) {
+    ulist_push(&_started, &s);
+  }
+  return rc;
+}
+
+int spawn_poll(void) {
+  struct ulist done = { .usize = sizeof(struct spawn*) };
+  struct pollfd *fds = 0;
+  int fds_cap = 0;
+
+  while (!done.num && _started.num) {
+    int nfds = 0;
+    if (fds_cap < 2 * _started.num + 1) {
+      fds_cap = 2 * _started.num + 1;
+      fds = xrealloc(fds, sizeof(*fds) * fds_cap);
+    }
+    for (int i = 0; i < _started.num; ++i) {
+      struct spawn *s = *(struct spawn**) ulist_get(&_started, i);
+      for (int j = 0; j < 2; ++j) {
+        fds[nfds++] = (struct pollfd) { .fd = s->fds[j], .events = POLLIN };
+      }
+    }
+    // Exit of a process which closed or detached its pipes is signaled by SIGCHLD handler
+    fds[nfds++] = (struct pollfd) { .fd = _sigchld_fds[0], .events = POLLIN };
+    if (poll(fds, nfds, -1) == -1 && errno != EINTR) {
+      akfatal(errno, "poll", 0);
+    }
+    _spawn_sigchld_drain();
+    // Exit is detected for each process on its own, so neither a process holding its pipes
+    // open by background descendants nor a process closed its pipes early blocks the others.
+    for (int i = 0, k = 0; i < _started.num; ++k) {
+      struct spawn *s = *(struct spawn**) ulist_get(&_started, i);
+      for (int j = 0; j < 2; ++j) {
+        if (s->fds[j] != -1) {
+          _spawn_read(s, j, fds[2 * k + j].revents);
         }
       }
-
-      if (waitpid(s->pid, &s->wstatus, 0) == -1) {
-        perror("waitpid");
+      if (_spawn_exited(s)) {
+        _spawn_drain(s);
+        ulist_push(&done, &s);
+        ulist_remove(&_started, i);
+      } else {
+        ++i;
       }
     }
   }
+  free(fds);
 
-  if (rc) {
-    akerror(rc, "Failed to spawn: %s", file);
+  // Handlers may start new processes
+  for (int i = 0; i < done.num; ++i) {
+    struct spawn *s = *(struct spawn**) ulist_get(&done, i);
+    if (s->exit_handler) {
+      s->exit_handler(s);
+    }
   }
-  return rc;
+  ulist_destroy_keep(&done);
+  return _started.num;
 }
 
 void spawn_destroy(struct spawn *s) {
   if (s) {
+    for (int i = 0; i < _started.num; ++i) {
+      if (*(struct spawn**) ulist_get(&_started, i) == s) {
+        ulist_remove(&_started, i);
+        break;
+      }
+    }
+    _spawn_pipe_close(s->fds);
     free(s->path_overriden);
     ulist_destroy_keep(&s->args);
     ulist_destroy_keep(&s->env);
@@ -33,14 +33,33 @@ void spawn_set_stdout_handler(struct spawn*, void (*handler)(char *buf, size_t b
 
 void spawn_set_stderr_handler(struct spawn*, void (*handler)(char *buf, size_t buflen, struct spawn*));
 
+/// Redirects stdin of spawned process from the given file.
+void spawn_set_stdin_file(struct spawn*, const char *path);
+
+/// Redirects stdout of spawned process into the given file, file is truncated.
+void spawn_set_stdout_file(struct spawn*, const char *path);
+
 void spawn_visit_cmd(struct spawn*, void *user_data, void (*visitor)(int num, const char *arg, void*));
 
-void spawn_set_nowait(struct spawn*, bool nowait);
+void spawn_set_silent(struct spawn*, bool silent);
 
-void spawn_set_wstatus(struct spawn*, int wstatus);
+/// Sets handler called by spawn_poll() when process started by spawn_start() is finished.
+void spawn_set_exit_handler(struct spawn*, void (*handler)(struct spawn*));
 
+/// Runs process and waits for its completion.
 int spawn_do(struct spawn*);
 
+/// Starts process without waiting for its completion.
+int spawn_start(struct spawn*);
+
+/// Waits until any of started processes is finished. Dispatches output of started processes
+/// to their stdout/stderr handlers and calls exit handlers of finished ones.
+/// Returns number of processes still running.
+int spawn_poll(void);
+
 void spawn_destroy(struct spawn*);
 
+/// Releases environment block and PATH lookups cached for spawned processes.
+void spawn_dispose(void);
+
 #endif
@@ -0,0 +1,4 @@
+#!/bin/sh
+
+set -e
+autark set HAVE_C=1
@@ -0,0 +1,7 @@
+void b(void);
+
+int main(void) {
+  puts(GREETING);
+  b();
+  return 0;
+}
@@ -0,0 +1,7 @@
+static int a_value(void) {
+  return 1;
+}
+
+int a(void) {
+  return a_value();
+}
@@ -0,0 +1,7 @@
+static int b_value(void) {
+  return 2;
+}
+
+int b(void) {
+  return b_value();
+}
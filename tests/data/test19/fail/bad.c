@@ -0,0 +1,6 @@
+// Header is created by test after the first failed build
+#include "fix.h"
+
+int bad(void) {
+  return FIX;
+}
@@ -0,0 +1,3 @@
+int c(void) {
+  return 3;
+}
@@ -0,0 +1,6 @@
+export module m;
+import n;
+
+export int m() {
+  return n() + 1;
+}
@@ -0,0 +1,7 @@
+import m;
+
+int other();
+
+int main() {
+  return m() + other() == 2 ? 0 : 1;
+}
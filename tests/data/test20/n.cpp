@@ -0,0 +1,5 @@
+export module n;
+
+export int n() {
+  return 1;
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Minimal P1689 scanner: scan.sh -format=p1689 -- COMPILER FLAGS -c SOURCE -o OBJECT
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -c) SRC="$2"; shift ;;
+    -o) OBJ="$2"; shift ;;
+  esac
+  shift
+done
+awk -v obj="$OBJ" '
+/^export module / { sub(/;.*/, "", $3); prov = $3 }
+/^(export )?import / { n = ($1 == "export") ? $3 : $2; sub(/;.*/, "", n); reqs = reqs sep "{ \"logical-name\": \"" n "\" }"; sep = ", " }
+END {
+  printf "{\n  \"version\": 1,\n  \"revision\": 0,\n  \"rules\": [ {\n    \"primary-output\": \"%s\"", obj
+  if (prov != "") {
+    printf ",\n    \"provides\": [ { \"logical-name\": \"%s\", \"is-interface\": true } ]", prov
+  }
+  printf ",\n    \"requires\": [ %s ]\n  } ]\n}\n", reqs
+}' "$SRC"
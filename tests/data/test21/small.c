@@ -0,0 +1,3 @@
+int small(void) {
+  return 1;
+}
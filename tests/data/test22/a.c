@@ -0,0 +1,5 @@
+#include "h.h"
+
+int a(void) {
+  return H_VALUE;
+}
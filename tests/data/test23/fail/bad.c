@@ -0,0 +1,4 @@
+// Preprocessed without errors, fails to compile
+int bad(void) {
+  return 1 +;
+}
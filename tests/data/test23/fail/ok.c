@@ -0,0 +1,3 @@
+int ok(void) {
+  return 1;
+}
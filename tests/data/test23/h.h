@@ -0,0 +1 @@
+#define H_VALUE 1
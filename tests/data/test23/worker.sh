@@ -0,0 +1,8 @@
+#!/bin/sh
+# Executor stand-in: compiles preprocessed source read from stdin, writes object to stdout.
+set -e
+tmp=$(mktemp)
+trap 'rm -f "$tmp" "$tmp.o"' EXIT
+cat > "$tmp"
+"$@" "$tmp" -o "$tmp.o" >&2
+cat "$tmp.o"
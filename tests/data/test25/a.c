@@ -0,0 +1 @@
+int a(void) { return 1; }
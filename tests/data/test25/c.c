@@ -0,0 +1 @@
+int c(void) { return 3; }
@@ -0,0 +1,6 @@
+#warning a-first
+#warning a-second
+
+int a(void) {
+  return 1;
+}
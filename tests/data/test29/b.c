@@ -0,0 +1,6 @@
+#warning b-first
+#warning b-second
+
+int b(void) {
+  return 2;
+}
@@ -0,0 +1,3 @@
+int bad(void) {
+  return undefined_var;
+}
@@ -1,6 +1,7 @@
 #include "test_utils.h"
 #include "log.h"
 #include "xstr.h"
+#include "script.h"
 #include <unistd.h>
 
 int main(void) {
@@ -15,6 +16,28 @@ int main(void) {
   ASSERT(assert, cmp_file_with_xstr("../../tests/data/test1/Autark.dump", xstr) == 0);
 
   script_close(&p);
+
+  // Second parse is served from the binary AST cache
+  rc = test_script_parse("../../tests/data/test1/Autark", &p);
+  ASSERT(assert, rc == 0);
+
+  xstr_clear(xstr);
+  script_dump(p, xstr);
+  ASSERT(assert, cmp_file_with_xstr("../../tests/data/test1/Autark.dump", xstr) == 0);
+
+  script_close(&p);
+
+  // Keywords are resolved only for unprefixed keys
+  rc = test_script_parse("../../tests/data/test1/prefixed/Autark", &p);
+  ASSERT(assert, rc == 0);
+  struct node *n = p->root->child;
+  ASSERT(assert, n && n->type == NODE_TYPE_RUN);
+  ASSERT(assert, n->child && n->child->kw == NODE_KW_CONSUMES);
+  ASSERT(assert, n->child->next && n->child->next->kw == NODE_KW_NONE);
+  ASSERT(assert, n->child->next->next && n->child->next->next->kw == NODE_KW_NONE);
+  ASSERT(assert, node_find_direct_child(n, NODE_TYPE_BAG, NODE_KW_CONSUMES) == n->child);
+  script_close(&p);
+
   xstr_destroy(xstr);
 
   if (rc) {
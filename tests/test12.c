@@ -0,0 +1,83 @@
+#include "test_utils.h"
+#include "map.h"
+#include "alloc.h"
+
+#include <stdlib.h>
+
+static void _test_map_u32(void) {
+  struct map *m = map_create_u32(0);
+  for (uint32_t i = 1; i <= 10000; ++i) {
+    map_put_u32(m, i, (void*) (uintptr_t) (i * 2));
+  }
+  akassert(map_count(m) == 10000);
+  for (uint32_t i = 1; i <= 10000; i += 2) {
+    akassert(map_remove_u32(m, i));
+  }
+  akassert(!map_remove_u32(m, 1));
+  akassert(map_count(m) == 5000);
+  for (uint32_t i = 1; i <= 10000; ++i) {
+    void *v = map_get_u32(m, i);
+    akassert((i & 1) ? v == 0 : v == (void*) (uintptr_t) (i * 2));
+  }
+  // Reuse tombstones
+  for (int r = 0; r < 10; ++r) {
+    for (uint32_t i = 20001; i <= 30000; ++i) {
+      map_put_u32(m, i, (void*) (uintptr_t) i);
+    }
+    for (uint32_t i = 20001; i <= 30000; ++i) {
+      akassert(map_remove_u32(m, i));
+    }
+  }
+  akassert(map_count(m) == 5000);
+
+  int cnt = 0;
+  struct map_iter it;
+  map_iter_init(m, &it);
+  while (map_iter_next(&it)) {
+    uint32_t k = (uint32_t) (uintptr_t) it.key;
+    akassert(!(k & 1) && it.val == (void*) (uintptr_t) (k * 2));
+    ++cnt;
+  }
+  akassert(cnt == 5000);
+
+  map_clear(m);
+  akassert(map_count(m) == 0);
+  akassert(map_get_u32(m, 2) == 0);
+  map_destroy(m);
+}
+
+static void _test_map_str(void) {
+  char buf[64];
+  struct map *m = map_create_str(map_kv_free);
+  for (int i = 0; i < 5000; ++i) {
+    snprintf(buf, sizeof(buf), "key-%d", i);
+    map_put_str(m, buf, xstrdup(buf));
+  }
+  // Replace existing value
+  map_put_str(m, "key-7", xstrdup("seven"));
+  akassert(map_count(m) == 5000);
+  akassert(strcmp(map_get(m, "key-7"), "seven") == 0);
+  for (int i = 0; i < 5000; i += 3) {
+    snprintf(buf, sizeof(buf), "key-%d", i);
+    akassert(map_remove(m, buf));
+  }
+  for (int i = 0; i < 5000; ++i) {
+    snprintf(buf, sizeof(buf), "key-%d", i);
+    const char *v = map_get(m, buf);
+    if (i % 3 == 0) {
+      akassert(v == 0);
+    } else if (i != 7) {
+      akassert(v && strcmp(v, buf) == 0);
+    }
+  }
+  akassert(map_get(m, "") == 0);
+  map_put_str(m, "", xstrdup("empty"));
+  akassert(strcmp(map_get(m, ""), "empty") == 0);
+  map_destroy(m);
+}
+
+int main(void) {
+  _test_map_u32();
+  _test_map_str();
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "test_utils.h"
+#include "vlist.h"
+
+#include <string.h>
+
+#define NUM_ITEMS 5000
+#define NUM_LAYERS 50
+
+static void _test_vlist_basic(void) {
+  struct vlist *s = vlist_create_from_str("foo");
+  akassert(s->scalar && s->num == 1 && !vlist_is_list(s));
+  akassert(strcmp(vlist_str(s), "foo") == 0);
+
+  struct vlist *l = vlist_create_from_str("\1a\1\1bb\1c");
+  akassert(vlist_is_list(l) && l->num == 3);
+  akassert(strcmp(vlist_item(l, 1)->ptr, "bb") == 0 && vlist_item(l, 1)->len == 2);
+  akassert(strcmp(vlist_str(l), "\1a\1bb\1c") == 0);
+
+  struct vlist *e = vlist_create_from_str("");
+  akassert(e->scalar && !vlist_is_list(e) && strcmp(vlist_str(e), "") == 0);
+
+  struct vlist *sp = vlist_create();
+  vlist_add_split(sp, " x 'y z'  \"w\\\"\" ");
+  akassert(sp->num == 3);
+  akassert(strcmp(vlist_str(sp), "\1x\1y z\1w\"") == 0);
+
+  vlist_release(sp);
+  vlist_release(e);
+  vlist_release(l);
+  vlist_release(s);
+}
+
+static void _test_vlist_share(void) {
+  struct vlist *base = vlist_create_from_str("\1a\1b");
+
+  // The first extension shares base store
+  struct vlist *l1 = vlist_create_from(base);
+  vlist_add(l1, "c", 1);
+  akassert(l1->store == base->store && l1->num == 3 && base->num == 2);
+
+  // The second one copies item slices
+  struct vlist *l2 = vlist_create_from(base);
+  vlist_add(l2, "d", 1);
+  akassert(l2->store != base->store);
+
+  vlist_add_list(l2, l1);
+  akassert(strcmp(vlist_str(base), "\1a\1b") == 0);
+  akassert(strcmp(vlist_str(l1), "\1a\1b\1c") == 0);
+  akassert(strcmp(vlist_str(l2), "\1a\1b\1d\1a\1b\1c") == 0);
+
+  vlist_release(base);
+  vlist_release(l1);
+  akassert(strcmp(vlist_item(l2, 5)->ptr, "c") == 0);
+  vlist_release(l2);
+}
+
+static void _test_vlist_extend(void) {
+  // Scalar list created from scalar base
+  struct vlist *s = vlist_create_from_str("foo");
+  struct vlist *s1 = vlist_create_from(s);
+  akassert(s1->scalar && strcmp(vlist_str(s1), "foo") == 0);
+
+  // List is extended after its string form is materialized
+  vlist_add(s1, "bar", 3);
+  akassert(!s1->scalar && strcmp(vlist_str(s1), "\1foo\1bar") == 0);
+  vlist_add(s1, "baz", 3);
+  akassert(strcmp(vlist_str(s1), "\1foo\1bar\1baz") == 0);
+
+  vlist_release(s1);
+  vlist_release(s);
+}
+
+static void _test_vlist_spread(void) {
+  char buf[64];
+
+  // set { X ..${X} item } repeated through several layers
+  struct vlist *l = vlist_create();
+  for (int i = 0; i < NUM_ITEMS; ++i) {
+    struct vlist *nl = vlist_create_from(l);
+    snprintf(buf, sizeof(buf), "/build/obj/file%d.o", i);
+    vlist_add(nl, buf, strlen(buf));
+    vlist_release(l);
+    l = nl;
+  }
+  for (int i = 0; i < NUM_LAYERS; ++i) {
+    struct vlist *nl = vlist_create_from(l);
+    vlist_add(nl, "extra.o", 7);
+    vlist_release(l);
+    l = nl;
+  }
+  akassert(l->num == NUM_ITEMS + NUM_LAYERS);
+  akassert(vlist_str(l)[0] == '\1');
+  vlist_release(l);
+}
+
+int main(void) {
+  _test_vlist_basic();
+  _test_vlist_share();
+  _test_vlist_extend();
+  _test_vlist_spread();
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <sys/wait.h>
+
+static void _build(const char *target) {
+  struct sctx *sctx;
+  struct ulist targets = { .usize = sizeof(char*) };
+  ulist_push(&targets, &target);
+  int rc = script_open("../../tests/data/test14/Autark", &sctx);
+  akassert(rc == 0);
+  script_build_targets(sctx, &targets);
+  script_close(&sctx);
+  ulist_destroy_keep(&targets);
+}
+
+int main(void) {
+  char cwd_prev[PATH_MAX];
+  akassert(getcwd(cwd_prev, sizeof(cwd_prev)));
+
+  // Alias builds its products and everything they consume
+  test_init(true);
+  _build("first");
+  akassert(access("autark-cache/one.txt", F_OK) == 0);
+  akassert(access("autark-cache/three.txt", F_OK) == 0);
+  akassert(access("autark-cache/two.txt", F_OK) != 0);
+
+  // Product by path suffix
+  chdir(cwd_prev);
+  test_reinit(true);
+  _build("two.txt");
+  akassert(access("autark-cache/two.txt", F_OK) == 0);
+  akassert(access("autark-cache/one.txt", F_OK) != 0);
+
+  // Nested aliases
+  chdir(cwd_prev);
+  test_reinit(true);
+  _build("all");
+  akassert(access("autark-cache/one.txt", F_OK) == 0);
+  akassert(access("autark-cache/two.txt", F_OK) == 0);
+  akassert(access("autark-cache/three.txt", F_OK) == 0);
+
+  // Duplicate alias name is an error
+  chdir(cwd_prev);
+  test_reinit(true);
+  pid_t pid = fork();
+  akassert(pid != -1);
+  if (pid == 0) {
+    struct sctx *sctx;
+    akassert(script_open("../../tests/data/test14/dup/Autark", &sctx) == 0);
+    script_build(sctx);
+    _exit(0);
+  }
+  int wstatus = 0;
+  akassert(waitpid(pid, &wstatus, 0) == pid);
+  akassert(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 0);
+  return 0;
+}
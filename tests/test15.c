@@ -0,0 +1,22 @@
+#include "test_utils.h"
+#include "script.h"
+
+int main(void) {
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+
+  struct sctx *sctx;
+  int rc = script_open("../../tests/data/test15/Autark", &sctx);
+  akassert(rc == 0);
+  script_build(sctx);
+  script_close(&sctx);
+
+  // Check providing unreferenced HAVE_B is never executed
+  akassert(strstr(xstr_ptr(xlog), "a.sh: resolved outdated"));
+  akassert(strstr(xstr_ptr(xlog), "c.sh: resolved outdated"));
+  akassert(!strstr(xstr_ptr(xlog), "b.sh"));
+  akassert(cmp_file_with_buf("autark-cache/out.txt", "1 1\n", 4) == 0);
+
+  xstr_destroy(g_env.check.log);
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "test_utils.h"
+#include "script.h"
+#include "manifest.h"
+
+#define SCRIPT "../../tests/data/test16/Autark"
+
+static void _build_script(const char *cwd, bool cleanup, const char *script) {
+  chdir(cwd);
+  test_reinit(cleanup);
+  manifest_init();
+  struct sctx *sctx;
+  int rc = script_open(script, &sctx);
+  akassert(rc == 0);
+  script_build(sctx);
+  manifest_save(sctx, "args");
+  script_close(&sctx);
+}
+
+static void _build(const char *cwd, bool cleanup) {
+  _build_script(cwd, cleanup, SCRIPT);
+}
+
+static bool _check(const char *cwd, const char *args) {
+  char buf[PATH_MAX];
+  chdir(cwd);
+  test_reinit(false);
+  autark_build_prepare(path_normalize(SCRIPT, buf));
+  return manifest_check(args);
+}
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  // Manifest is saved by the build which resolved outdated rules
+  _build(cwd, true);
+  akassert(cmp_file_with_buf("autark-cache/out.txt", "hello\n", 6) == 0);
+  akassert(access("autark-cache/" AUTARK_MANIFEST, F_OK) == 0);
+  akassert(_check(cwd, "args"));
+
+  // Changed command line invalidates the manifest
+  akassert(!_check(cwd, "other"));
+  akassert(access("autark-cache/" AUTARK_MANIFEST, F_OK) != 0);
+
+  // Removed product invalidates the manifest
+  _build(cwd, false);
+  akassert(_check(cwd, "args"));
+  unlink("autark-cache/out.txt");
+  akassert(!_check(cwd, "args"));
+
+  // Rebuild restores the product and saves the manifest again
+  _build(cwd, false);
+  akassert(cmp_file_with_buf("autark-cache/out.txt", "hello\n", 6) == 0);
+  akassert(_check(cwd, "args"));
+
+  // Manifest is not saved if some rule is outdated on every build
+  _build_script(cwd, false, "../../tests/data/test16/always/Autark");
+  akassert(access("autark-cache/out.txt", F_OK) != 0);
+  akassert(access("autark-cache/" AUTARK_MANIFEST, F_OK) != 0);
+  return 0;
+}
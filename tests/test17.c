@@ -0,0 +1,39 @@
+#include "test_utils.h"
+#include "script.h"
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test17/Autark");
+  akassert(test_glob_count("autark-cache/.pch-*/common.h.gch") == 1);
+  akassert(access("autark-cache/a.o", F_OK) == 0);
+  akassert(access("autark-cache/b.o", F_OK) == 0);
+  akassert(strstr(xstr_ptr(xlog), "build src=../a.c"));
+  akassert(strstr(xstr_ptr(xlog), "build src=../b.c"));
+  akassert(strstr(xstr_ptr(xlog), "pch build common.h"));
+  xstr_destroy(xlog);
+
+  // Nothing is changed
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test17/Autark");
+  akassert(!strstr(xstr_ptr(xlog), "build src="));
+  akassert(!strstr(xstr_ptr(xlog), "pch build"));
+  xstr_destroy(xlog);
+
+  // Edited header rebuilds precompiled header and all objects
+  chdir(cwd);
+  test_touch("../../tests/data/test17/common.h", 10);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test17/Autark");
+  akassert(strstr(xstr_ptr(xlog), "pch build common.h"));
+  akassert(strstr(xstr_ptr(xlog), "build src=../a.c"));
+  akassert(strstr(xstr_ptr(xlog), "build src=../b.c"));
+  xstr_destroy(xlog);
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <stdlib.h>
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test18/Autark");
+  akassert(strstr(xstr_ptr(xlog), "/unity_0.c obj="));
+  akassert(strstr(xstr_ptr(xlog), "/unity_1.c obj="));
+  akassert(!strstr(xstr_ptr(xlog), "build src=../a.c"));
+  akassert(system("./autark-cache/test18") == 0);
+  xstr_destroy(xlog);
+
+  // Edited source is detached from its unity file
+  chdir(cwd);
+  test_reinit(false);
+  test_touch("../../tests/data/test18/b.c", 10);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test18/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../b.c"));
+  akassert(strstr(xstr_ptr(xlog), "/unity_0.c obj="));
+  akassert(!strstr(xstr_ptr(xlog), "/unity_1.c obj="));
+  akassert(system("./autark-cache/test18") == 0);
+  xstr_destroy(xlog);
+
+  // Subsequent edits recompile only detached source
+  chdir(cwd);
+  test_reinit(false);
+  test_touch("../../tests/data/test18/b.c", 20);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test18/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../b.c"));
+  akassert(!strstr(xstr_ptr(xlog), "/unity_0.c obj="));
+  akassert(!strstr(xstr_ptr(xlog), "/unity_1.c obj="));
+  xstr_destroy(xlog);
+
+  // Nothing is changed
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test18/Autark");
+  akassert(!strstr(xstr_ptr(xlog), "build src="));
+  xstr_destroy(xlog);
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <stdlib.h>
+#include <sys/wait.h>
+
+// Returns content of the only deps file of the cc rule
+static struct value _deps_read(const char *cache_dir) {
+  char pattern[PATH_MAX];
+  glob_t g;
+  snprintf(pattern, sizeof(pattern), "%s/.*.deps", cache_dir);
+  akassert(glob(pattern, 0, 0, &g) == 0 && g.gl_pathc == 1);
+  struct value val = utils_file_as_buf(g.gl_pathv[0], 1024 * 1024);
+  akassert(val.buf);
+  globfree(&g);
+  return val;
+}
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test19/Autark");
+  akassert(strstr(xstr_ptr(xlog), "batch num=3"));
+  akassert(strstr(xstr_ptr(xlog), "build src=../main.c"));
+  akassert(access("autark-cache/a.o", F_OK) == 0);
+  akassert(access("autark-cache/a.d", F_OK) == 0);
+  akassert(access("autark-cache/c.o", F_OK) == 0);
+  akassert(access("autark-cache/main.o", F_OK) == 0);
+  akassert(system("./autark-cache/test19") == 0);
+  xstr_destroy(xlog);
+
+  // Sources are tracked individually
+  chdir(cwd);
+  test_reinit(false);
+  test_touch("../../tests/data/test19/b.c", 10);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test19/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../b.c"));
+  akassert(!strstr(xstr_ptr(xlog), "build src=../a.c"));
+  akassert(!strstr(xstr_ptr(xlog), "batch num="));
+  xstr_destroy(xlog);
+
+  // Nothing is changed
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test19/Autark");
+  akassert(!strstr(xstr_ptr(xlog), "build src="));
+  xstr_destroy(xlog);
+
+  // Failed member of batch is charged to its own source, failed build is run in child process
+  chdir(cwd);
+  test_reinit(true);
+  pid_t pid = fork();
+  akassert(pid != -1);
+  if (pid == 0) {
+    test_build("../../tests/data/test19/fail/Autark");
+    _exit(0);
+  }
+  int wstatus = 0;
+  akassert(waitpid(pid, &wstatus, 0) == pid);
+  akassert(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 0);
+
+  struct value val = _deps_read("../../tests/data/test19/fail/autark-cache");
+  char dir[PATH_MAX], line[PATH_MAX + 16];
+  akassert(path_normalize("../../tests/data/test19/fail", dir));
+  snprintf(line, sizeof(line), "fs%s/bad.c\1" "0\n", dir);
+  akassert(strstr(val.buf, line));
+  snprintf(line, sizeof(line), "fs%s/a.c\1", dir);
+  akassert(strstr(val.buf, line) && !strstr(val.buf, strcat(line, "0\n")));
+  snprintf(line, sizeof(line), "fs%s/c.c\1", dir);
+  akassert(strstr(val.buf, line) && !strstr(val.buf, strcat(line, "0\n")));
+  value_destroy(&val);
+
+  // Only the failed source is compiled again
+  akassert(utils_file_write_buf("../../tests/data/test19/fail/autark-cache/fix.h", "#define FIX 2\n", 14, false) == 0);
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test19/fail/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../bad.c"));
+  akassert(!strstr(xstr_ptr(xlog), "build src=../a.c"));
+  akassert(!strstr(xstr_ptr(xlog), "build src=../c.c"));
+  xstr_destroy(xlog);
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <stdlib.h>
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test20/Autark");
+  const char *log = xstr_ptr(xlog);
+  const char *n = strstr(log, "build src=../n.cpp");
+  const char *m = strstr(log, "build src=../m.cpp");
+  const char *main = strstr(log, "build src=../main.cpp");
+  akassert(n && m && main && n < m && m < main);
+  akassert(access("autark-cache/gcm.cache/m.gcm", F_OK) == 0);
+  akassert(system("./autark-cache/test20") == 0);
+  xstr_destroy(xlog);
+
+  // Dependents of changed module interface are rebuilt
+  chdir(cwd);
+  test_reinit(false);
+  test_touch("../../tests/data/test20/n.cpp", 10);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test20/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "build src=../n.cpp"));
+  akassert(strstr(log, "build src=../m.cpp"));
+  akassert(strstr(log, "build src=../main.cpp"));
+  akassert(!strstr(log, "build src=../other.cpp"));
+  akassert(system("./autark-cache/test20") == 0);
+  xstr_destroy(xlog);
+
+  // Changed importer does not rebuild imported modules
+  chdir(cwd);
+  test_reinit(false);
+  test_touch("../../tests/data/test20/main.cpp", 20);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test20/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "build src=../main.cpp"));
+  akassert(!strstr(log, "build src=../m.cpp"));
+  akassert(!strstr(log, "build src=../n.cpp"));
+  xstr_destroy(xlog);
+
+  // Nothing is changed
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test20/Autark");
+  akassert(!strstr(xstr_ptr(xlog), "build src="));
+  xstr_destroy(xlog);
+  return 0;
+}
@@ -0,0 +1,36 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <glob.h>
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  // Without history larger sources are compiled first
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test21/Autark");
+  const char *small = strstr(xstr_ptr(xlog), "build src=../small.c");
+  const char *large = strstr(xstr_ptr(xlog), "build src=../large.c");
+  akassert(small && large && large < small);
+  xstr_destroy(xlog);
+
+  // Recorded compile times take precedence
+  glob_t g;
+  akassert(glob("autark-cache/.*.times", 0, 0, &g) == 0 && g.gl_pathc == 1);
+  const char *times = "5000 ../small.c\n10 ../large.c\n";
+  akassert(utils_file_write_buf(g.gl_pathv[0], times, strlen(times), false) == 0);
+  globfree(&g);
+
+  chdir(cwd);
+  test_reinit(false);
+  akassert(system("touch ../../tests/data/test21/small.c ../../tests/data/test21/large.c") == 0);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test21/Autark");
+  small = strstr(xstr_ptr(xlog), "build src=../small.c");
+  large = strstr(xstr_ptr(xlog), "build src=../large.c");
+  akassert(small && large && small < large);
+  xstr_destroy(xlog);
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <glob.h>
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test22/Autark");
+  xstr_destroy(xlog);
+
+  // Without changed sources the longest goes first
+  glob_t g;
+  akassert(glob("autark-cache/.*.times", 0, 0, &g) == 0 && g.gl_pathc == 1);
+  char *tpath = xstrdup(g.gl_pathv[0]);
+  globfree(&g);
+  const char *times = "5000 ../a.c\n10 ../b.c\n";
+  akassert(utils_file_write_buf(tpath, times, strlen(times), false) == 0);
+
+  chdir(cwd);
+  test_reinit(false);
+  akassert(system("touch ../../tests/data/test22/h.h") == 0);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test22/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../a.c"));
+  akassert(!strstr(xstr_ptr(xlog), "build src=../b.c"));
+  xstr_destroy(xlog);
+
+  // Edited source goes ahead of the source outdated by included header
+  akassert(utils_file_write_buf(tpath, times, strlen(times), false) == 0);
+  chdir(cwd);
+  test_reinit(false);
+  akassert(system("touch ../../tests/data/test22/h.h ../../tests/data/test22/b.c") == 0);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test22/Autark");
+  const char *a = strstr(xstr_ptr(xlog), "build src=../a.c");
+  const char *b = strstr(xstr_ptr(xlog), "build src=../b.c");
+  akassert(a && b && b < a);
+  xstr_destroy(xlog);
+  free(tpath);
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <stdlib.h>
+#include <sys/wait.h>
+
+static void _init(bool cleanup) {
+  test_reinit(cleanup);
+  const char *worker = path_normalize_pool("../../tests/data/test23/worker.sh", g_env.pool);
+  g_env.executor.cmd = pool_printf(g_env.pool, "sh %s", worker);
+  g_env.executor.jobs = 4;
+}
+
+// Compile jobs are executed by `autark worker` shipped with autark
+static void _init_worker(bool cleanup) {
+  test_reinit(cleanup);
+  const char *autark = path_normalize_pool("../autark", g_env.pool);
+  g_env.executor.cmd = pool_printf(g_env.pool, "%s worker", autark);
+  g_env.executor.jobs = 4;
+}
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  _init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test23/Autark");
+  const char *log = xstr_ptr(xlog);
+  akassert(strstr(log, "remote src=../a.c obj=a.o"));
+  akassert(strstr(log, "remote src=../b.c obj=b.o"));
+  akassert(strstr(log, "remote src=../main.c obj=main.o"));
+  akassert(access("autark-cache/a.i", F_OK) != 0);
+  akassert(system("./autark-cache/test23") == 0);
+  xstr_destroy(xlog);
+
+  // Dependencies are tracked by locally preprocessed sources
+  chdir(cwd);
+  test_touch("../../tests/data/test23/h.h", 2);
+  _init(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test23/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "remote src=../a.c obj=a.o"));
+  akassert(!strstr(log, "src=../b.c"));
+  akassert(!strstr(log, "src=../main.c"));
+  akassert(system("./autark-cache/test23") == 0);
+  xstr_destroy(xlog);
+
+  // The same with `autark worker` executor
+  chdir(cwd);
+  _init_worker(true);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test23/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "remote src=../a.c obj=a.o"));
+  akassert(strstr(log, "remote src=../b.c obj=b.o"));
+  akassert(strstr(log, "remote src=../main.c obj=main.o"));
+  akassert(system("./autark-cache/test23") == 0);
+  xstr_destroy(xlog);
+
+  chdir(cwd);
+  test_touch("../../tests/data/test23/h.h", 4);
+  _init_worker(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test23/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "remote src=../a.c obj=a.o"));
+  akassert(!strstr(log, "src=../b.c"));
+  akassert(!strstr(log, "src=../main.c"));
+  akassert(system("./autark-cache/test23") == 0);
+  xstr_destroy(xlog);
+
+  // Source is preprocessed locally but fails to compile by worker, failed build is run in child process
+  chdir(cwd);
+  _init_worker(true);
+  pid_t pid = fork();
+  akassert(pid != -1);
+  if (pid == 0) {
+    test_build("../../tests/data/test23/fail/Autark");
+    _exit(0);
+  }
+  int wstatus = 0;
+  akassert(waitpid(pid, &wstatus, 0) == pid);
+  akassert(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 0);
+  akassert(access("../../tests/data/test23/fail/autark-cache/bad.o", F_OK) != 0);
+  akassert(access("../../tests/data/test23/fail/autark-cache/ok.o", F_OK) == 0);
+  return 0;
+}
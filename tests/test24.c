@@ -0,0 +1,136 @@
+#include "test_utils.h"
+#include "spawn.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+
+static int _num_exited;
+static struct spawn *_exited[8];
+
+static void _stdout_handler(char *buf, size_t buflen, struct spawn *s) {
+  xstr_cat2(spawn_user_data(s), buf, buflen);
+}
+
+static void _stderr_handler(char *buf, size_t buflen, struct spawn *s) {
+  xstr_cat2(spawn_user_data(s), "E:", 2);
+  xstr_cat2(spawn_user_data(s), buf, buflen);
+}
+
+static void _exit_handler(struct spawn *s) {
+  _exited[_num_exited++ % 8] = s;
+}
+
+static int64_t _now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static struct spawn* _start(const char *script, struct xstr *out) {
+  struct spawn *s = spawn_create("sh", out);
+  spawn_arg_add(s, "-c");
+  spawn_arg_add(s, script);
+  spawn_set_silent(s, true);
+  spawn_set_stdout_handler(s, _stdout_handler);
+  spawn_set_stderr_handler(s, _stderr_handler);
+  spawn_set_exit_handler(s, _exit_handler);
+  akassert(spawn_start(s) == 0);
+  return s;
+}
+
+int main(void) {
+  test_init(false);
+
+  // Unrelated child process is not reaped by spawn_poll()
+  pid_t other = fork();
+  akassert(other != -1);
+  if (other == 0) {
+    _exit(7);
+  }
+
+  struct xstr *out1 = xstr_create_empty();
+  struct xstr *out2 = xstr_create_empty();
+  struct xstr *out3 = xstr_create_empty();
+  struct spawn *s1 = _start("sleep 0.2; echo one", out1);
+  struct spawn *s2 = _start("echo two; exit 3", out2);
+  struct spawn *s3 = _start("echo three >&2", out3);
+
+  int running;
+  while ((running = spawn_poll()) > 0) {
+    akassert(running < 3);
+  }
+  akassert(_num_exited == 3);
+  akassert(strcmp(xstr_ptr(out1), "one\n") == 0);
+  akassert(strcmp(xstr_ptr(out2), "two\n") == 0);
+  akassert(strcmp(xstr_ptr(out3), "E:three\n") == 0);
+  akassert(spawn_exit_code(s1) == 0);
+  akassert(spawn_exit_code(s2) == 3);
+  akassert(spawn_exit_code(s3) == 0);
+  akassert(spawn_poll() == 0);
+
+  int wstatus = 0;
+  akassert(waitpid(other, &wstatus, 0) == other);
+  akassert(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 7);
+
+  // Synchronous spawn
+  xstr_clear(out1);
+  struct spawn *s4 = spawn_create("sh", out1);
+  spawn_arg_add(s4, "-c");
+  spawn_arg_add(s4, "echo four");
+  spawn_set_stdout_handler(s4, _stdout_handler);
+  akassert(spawn_do(s4) == 0);
+  akassert(spawn_exit_code(s4) == 0);
+  akassert(strcmp(xstr_ptr(out1), "four\n") == 0);
+
+  // Process which closed its pipes early doesn't delay exit of others
+  _num_exited = 0;
+  xstr_clear(out1);
+  xstr_clear(out2);
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  long nvcsw = ru.ru_nvcsw;
+  struct spawn *s5 = _start("exec >&- 2>&-; sleep 1", out1);
+  struct spawn *s6 = _start("sleep 0.1; echo six", out2);
+  while (spawn_poll() > 0) ;
+  akassert(_num_exited == 2);
+  // Exit of process without pipes is awaited without frequent wakeups
+  getrusage(RUSAGE_SELF, &ru);
+  akassert(ru.ru_nvcsw - nvcsw < 100);
+  akassert(_exited[0] == s6 && _exited[1] == s5);
+  akassert(strcmp(xstr_ptr(out2), "six\n") == 0);
+
+  // Output pipes held open by background process don't block exit of its parent
+  _num_exited = 0;
+  xstr_clear(out1);
+  int64_t ts = _now_ms();
+  struct spawn *s7 = _start("sleep 3 & echo seven", out1);
+  while (spawn_poll() > 0) ;
+  akassert(_num_exited == 1 && _exited[0] == s7);
+  akassert(strcmp(xstr_ptr(out1), "seven\n") == 0);
+  akassert(_now_ms() - ts < 2000);
+
+  xstr_clear(out1);
+  ts = _now_ms();
+  struct spawn *s8 = spawn_create("sh", out1);
+  spawn_arg_add(s8, "-c");
+  spawn_arg_add(s8, "sleep 3 & echo eight");
+  spawn_set_silent(s8, true);
+  spawn_set_stdout_handler(s8, _stdout_handler);
+  akassert(spawn_do(s8) == 0);
+  akassert(strcmp(xstr_ptr(out1), "eight\n") == 0);
+  akassert(_now_ms() - ts < 2000);
+
+  spawn_destroy(s1);
+  spawn_destroy(s2);
+  spawn_destroy(s3);
+  spawn_destroy(s4);
+  spawn_destroy(s5);
+  spawn_destroy(s6);
+  spawn_destroy(s7);
+  spawn_destroy(s8);
+  xstr_destroy(out1);
+  xstr_destroy(out2);
+  xstr_destroy(out3);
+  return 0;
+}
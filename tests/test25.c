@@ -0,0 +1,58 @@
+#include "test_utils.h"
+#include "script.h"
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test25/Autark");
+  const char *log = xstr_ptr(xlog);
+  akassert(strstr(log, "archive full members=3"));
+  akassert(!strstr(log, "archive update"));
+  akassert(system("ar t autark-cache/libt.a | grep -q b.o") == 0);
+  akassert(system("head -c 7 autark-cache/libthin.a | grep -q '!<thin>'") == 0);
+  xstr_destroy(xlog);
+
+  // Nothing is changed
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test25/Autark");
+  akassert(!strstr(xstr_ptr(xlog), " archive "));
+  xstr_destroy(xlog);
+
+  // Only the changed member is replaced
+  chdir(cwd);
+  test_touch("../../tests/data/test25/b.c", 2);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test25/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "archive update members=1"));
+  akassert(!strstr(log, "archive full"));
+  akassert(system("ar t autark-cache/libt.a | wc -l | grep -q 3") == 0);
+  xstr_destroy(xlog);
+
+  // Removed archive is rebuilt from scratch
+  chdir(cwd);
+  unlink("../../tests/data/test25/autark-cache/libt.a");
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test25/Autark");
+  akassert(strstr(xstr_ptr(xlog), "archive full members=3"));
+  xstr_destroy(xlog);
+
+  // Changed archiver in ${AR} rebuilds archives
+  chdir(cwd);
+  setenv("AR", "ar", 1);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test25/Autark");
+  log = xstr_ptr(xlog);
+  akassert(strstr(log, "archive full members=3"));
+  akassert(!strstr(log, "archive update"));
+  xstr_destroy(xlog);
+  return 0;
+}
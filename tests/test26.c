@@ -0,0 +1,34 @@
+#include "test_utils.h"
+#include "script.h"
+
+static const char *_changed;
+
+static void _on_built(void) {
+  test_touch(_changed, 5);
+}
+
+int main(void) {
+#ifdef __linux__
+  alarm(60);
+  test_init(true);
+  const char *src = path_normalize_pool("../../tests/data/test26/src/main.c", g_env.pool);
+  const char *script = path_normalize_pool("../../tests/data/test26/Autark", g_env.pool);
+
+  // Source dir known only from the build report is watched
+  struct sctx *sctx;
+  int rc = script_open(script, &sctx);
+  akassert(rc == 0);
+  _changed = src;
+  int brc = -1;
+  akassert(test_watch_cycle(sctx, _on_built, &brc) == 1);
+  akassert(brc == 0);
+  akassert(access("autark-cache/src/main.o", F_OK) == 0);
+
+  // Script change requires full re-evaluation
+  _changed = script;
+  akassert(test_watch_cycle(sctx, _on_built, &brc) == 2);
+  akassert(brc == 0);
+  script_close(&sctx);
+#endif
+  return 0;
+}
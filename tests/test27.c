@@ -0,0 +1,32 @@
+#include "test_utils.h"
+#include "script.h"
+
+int main(void) {
+  char cwd[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+
+  setenv("TEST_COMPILER", "cc", 1);
+  test_init(true);
+  struct xstr *xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test27/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../a.c"));
+  xstr_destroy(xlog);
+
+  // Nothing is changed
+  chdir(cwd);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test27/Autark");
+  akassert(!strstr(xstr_ptr(xlog), "build src=../a.c"));
+  xstr_destroy(xlog);
+
+  // Compiler set in ${CC} is changed
+  chdir(cwd);
+  setenv("TEST_COMPILER", "gcc", 1);
+  test_reinit(false);
+  xlog = g_env.check.log = xstr_create_empty();
+  test_build("../../tests/data/test27/Autark");
+  akassert(strstr(xstr_ptr(xlog), "build src=../a.c"));
+  xstr_destroy(xlog);
+  return 0;
+}
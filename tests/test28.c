@@ -0,0 +1,48 @@
+#include "test_utils.h"
+#include "script.h"
+#include "manifest.h"
+
+#define SCRIPT "../../tests/data/test28/Autark"
+
+static void _build(const char *cwd) {
+  chdir(cwd);
+  test_reinit(false);
+  manifest_init();
+  struct sctx *sctx;
+  int rc = script_open(SCRIPT, &sctx);
+  akassert(rc == 0);
+  script_build(sctx);
+  manifest_save(sctx, "args");
+  script_close(&sctx);
+}
+
+static bool _check(const char *cwd) {
+  char buf[PATH_MAX];
+  chdir(cwd);
+  test_reinit(false);
+  autark_build_prepare(path_normalize(SCRIPT, buf));
+  return manifest_check("args");
+}
+
+int main(void) {
+  char cwd[PATH_MAX], home[PATH_MAX], lib[PATH_MAX];
+  akassert(getcwd(cwd, sizeof(cwd)));
+  snprintf(home, sizeof(home), "%s/test28-home", cwd);
+  snprintf(lib, sizeof(lib), "%s/.local/lib/libzzqq.a", home);
+  setenv("HOME", home, 1);
+
+  test_init(true);
+  unlink(lib);
+  akassert(path_mkdirs_for(lib) == 0);
+  _build(cwd);
+  akassert(_check(cwd));
+
+  // Library appeared in one of probed locations invalidates the manifest
+  akassert(utils_file_write_buf(lib, "", 0, false) == 0);
+  akassert(!_check(cwd));
+
+  _build(cwd);
+  akassert(_check(cwd));
+  unlink(lib);
+  return 0;
+}
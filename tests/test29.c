@@ -0,0 +1,71 @@
+#include "test_utils.h"
+#include "script.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+
+// Checks the text between `first` and `second` markers is not interleaved with output of other tasks.
+static bool _is_block(const char *out, const char *first, const char *second, const char *other) {
+  const char *s = strstr(out, first);
+  const char *e = s ? strstr(s, second) : 0;
+  if (!e) {
+    return false;
+  }
+  for (const char *p = strstr(out, other); p; p = strstr(p + 1, other)) {
+    if (p > s && p < e) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(void) {
+  test_init(true);
+  g_env.max_parallel_jobs = 4;
+
+  // Failed build is run in child process, its console output is captured
+  const char *log = "test29-output.txt";
+  pid_t pid = fork();
+  akassert(pid != -1);
+  if (pid == 0) {
+    // Command lines of compile tasks are printed unconditionally in verbose mode
+    g_env.verbose = false;
+    int fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    akassert(fd != -1);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    test_build("../../tests/data/test29/Autark");
+    _exit(0);
+  }
+  int wstatus = 0;
+  akassert(waitpid(pid, &wstatus, 0) == pid);
+  akassert(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 0);
+
+  struct value val = utils_file_as_buf(log, 1024 * 1024);
+  akassert(val.buf);
+  const char *out = val.buf;
+
+  // Status line for every task
+  akassert(strstr(out, "] cc a.c\n"));
+  akassert(strstr(out, "] cc b.c\n"));
+  akassert(strstr(out, "] cc bad.c\n"));
+  akassert(strstr(out, "[3/3] cc "));
+
+  // Command line is printed only for the failed task
+  const char *st = strstr(out, "] cc bad.c\n");
+  const char *cmd = st + strlen("] cc bad.c\n");
+  const char *eol = strchr(cmd, '\n');
+  const char *c = strstr(out, " -c ");
+  akassert(eol && c > cmd && c < eol && !strstr(c + 1, " -c "));
+  akassert(strstr(cmd, "bad.c") < eol);
+
+  // Diagnostics of parallel tasks are not interleaved
+  akassert(_is_block(out, "a-first", "a-second", "b-first"));
+  akassert(_is_block(out, "a-first", "a-second", "undefined_var"));
+  akassert(_is_block(out, "b-first", "b-second", "a-first"));
+  akassert(_is_block(out, "b-first", "b-second", "undefined_var"));
+
+  value_destroy(&val);
+  unlink(log);
+  return 0;
+}
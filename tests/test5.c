@@ -1,6 +1,8 @@
 #include "test_utils.h"
 #include "script.h"
 
+#include <utime.h>
+
 int main(void) {
   test_init(true);
 
@@ -13,8 +15,9 @@ int main(void) {
   script_build(sctx);
   script_close(&sctx);
 
-  akassert(access("autark-cache/.autark/.2.deps", F_OK) == 0);
-  akassert(access("autark-cache/.autark/.2.env", F_OK) == 0);
+  // State files of check script are named after its content hash
+  akassert(test_glob_count("autark-cache/.autark/.*.deps") == 1);
+  akassert(test_glob_count("autark-cache/.autark/.*.env") == 1);
   akassert(access("autark-cache/.autark/test-file.txt", F_OK) == 0);
 
   struct akpath_stat st[6];
@@ -35,6 +38,18 @@ int main(void) {
   akassert(st[2].mtime == st[3].mtime);
   akassert(st[4].mtime == st[5].mtime);
 
+  // Touched script doesn't invalidate rules which inputs are not changed
+  chdir(cwd_prev);
+  akassert(utime("../../tests/data/test5/Autark", 0) == 0);
+  akassert(script_open("../../tests/data/test5/Autark", &sctx) == 0);
+  script_build(sctx);
+  script_close(&sctx);
+
+  akassert(path_stat("autark-cache/run1-product1.txt", &st[3]) == 0);
+  akassert(path_stat("autark-cache/run2-product1.txt", &st[5]) == 0);
+  akassert(st[2].mtime == st[3].mtime);
+  akassert(st[4].mtime == st[5].mtime);
+
   struct value v = utils_file_as_buf("autark-cache/run1-product2.txt", 1024);
   akassert(v.buf);
   akassert(strcmp(v.buf, "VAL2\n") == 0);
@@ -26,12 +26,12 @@ int main(void) {
     strcmp(
       "Autark:2   env.sh: resolved outdated outdated=0\n"
       "Autark:36     cc: resolved outdated outdated=0\n"
-      "Autark:36     cc: build src=../main.c obj=main.o\n"
       "Autark:36     cc: build src=../hello.c obj=hello.o\n"
+      "Autark:36     cc: build src=../main.c obj=main.o\n"
       "Autark:42    run: resolved outdated outdated=0\n"
       "Autark:42    run: cc\n"
       "Autark:42    run: /bin/sh\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   //---
@@ -70,7 +70,7 @@ int main(void) {
       "Autark:42    run: resolved outdated outdated=1\n"
       "Autark:42    run: cc\n"
       "Autark:42    run: /bin/sh\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   //---
@@ -87,17 +87,17 @@ int main(void) {
 
   akassert(
     strcmp(
-      "Autark:36     cc: outdated main.c t=a f=s\n"
       "Autark:36     cc: outdated hello.c t=a f=s\n"
+      "Autark:36     cc: outdated main.c t=a f=s\n"
       "Autark:36     cc: resolved outdated outdated=2\n"
-      "Autark:36     cc: build src=../main.c obj=main.o\n"
       "Autark:36     cc: build src=../hello.c obj=hello.o\n"
+      "Autark:36     cc: build src=../main.c obj=main.o\n"
       "Autark:42    run: outdated main.o t=f f= \n"
       "Autark:42    run: outdated hello.o t=f f= \n"
       "Autark:42    run: resolved outdated outdated=2\n"
       "Autark:42    run: cc\n"
       "Autark:42    run: /bin/sh\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   fprintf(stderr, "\n\n");
@@ -114,17 +114,17 @@ int main(void) {
   akassert(
     strcmp(
       "Autark:36     cc: outdated \1-DBUILD_TYPE=Debug\1-DDEBUG=1\1-O0\1-g t=v f= \n"
-      "Autark:36     cc: outdated main.c t=a f=s\n"
       "Autark:36     cc: outdated hello.c t=a f=s\n"
+      "Autark:36     cc: outdated main.c t=a f=s\n"
       "Autark:36     cc: resolved outdated outdated=3\n"
-      "Autark:36     cc: build src=../main.c obj=main.o\n"
       "Autark:36     cc: build src=../hello.c obj=hello.o\n"
+      "Autark:36     cc: build src=../main.c obj=main.o\n"
       "Autark:42    run: outdated main.o t=f f= \n"
       "Autark:42    run: outdated hello.o t=f f= \n"
       "Autark:42    run: resolved outdated outdated=2\n"
       "Autark:42    run: cc\n"
       "Autark:42    run: /bin/sh\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   xstr_destroy(g_env.check.log);
@@ -38,15 +38,15 @@ int main(void) {
       "libhello/Autark:2   libhello.sh: resolved outdated outdated=0\n"
       "libhello/Autark:29  configure: resolved outdated outdated=0\n"
       "Autark:46     cc: resolved outdated outdated=0\n"
-      "Autark:46     cc: build src=../main.c obj=main.o\n"
       "Autark:46     cc: build src=../aux.c obj=aux.o\n"
+      "Autark:46     cc: build src=../main.c obj=main.o\n"
       "libhello/Autark:10     cc: resolved outdated outdated=0\n"
       "libhello/Autark:10     cc: build src=../../libhello/hello.c obj=hello.o\n"
       "libhello/Autark:19    run: resolved outdated outdated=0\n"
       "libhello/Autark:19    run: ar\n"
       "Autark:58    run: resolved outdated outdated=0\n"
       "Autark:58    run: cc\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   //---
@@ -5,6 +5,7 @@ int main(void) {
   unsetenv("CC");
   unsetenv("CFLAGS");
   unsetenv("LDFLAGS");
+  unsetenv("TAG");
 
   test_init(true);
   struct xstr *xlog = g_env.check.log = xstr_create_empty();
@@ -31,7 +32,7 @@ int main(void) {
       "Autark:23    run: /bin/sh\n"
       "Autark:23    run: cc\n"
       "Autark:23    run: /bin/sh\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   struct value v = utils_file_as_buf("./autark-cache/tests.log", 1024 * 1024);
@@ -76,7 +77,7 @@ int main(void) {
       "Autark:23    run: resolved outdated outdated=1\n"
       "Autark:23    run: cc\n"
       "Autark:23    run: /bin/sh\n",
-      xstr_ptr(xlog)) == 0
+      test_log_normalize(xlog)) == 0
     );
 
   v = utils_file_as_buf("./autark-cache/tests.log", 1024 * 1024);
@@ -92,5 +93,35 @@ int main(void) {
     );
   value_destroy(&v);
 
+  //--- Variable read by the loop variable dependent argument is changed
+
+  fprintf(stderr, "\n\n");
+  chdir(cwd_prev);
+  setenv("TAG", "_tag", 1);
+  test_reinit(false);
+  g_env.check.log = xstr_clear(xlog);
+  akassert(script_open("../../tests/data/test8/Autark", &sctx) == 0);
+  script_build(sctx);
+  script_close(&sctx);
+  unsetenv("TAG");
+  akassert(strstr(xstr_ptr(xlog), "run: resolved outdated outdated=1\n"));
+
+  v = utils_file_as_buf("./autark-cache/tests.log", 1024 * 1024);
+  akassert(!v.error);
+  akassert(
+    strcmp(
+      "test8_1\n"
+      "test8_2\n"
+      "test8_3\n"
+      "test8_4\n"
+      "test8_2\n"
+      "test8_1\n"
+      "test8_2\n"
+      "test8_3\n"
+      "test8_4\n",
+      v.buf) == 0
+    );
+  value_destroy(&v);
+
   xstr_destroy(xlog);
 }
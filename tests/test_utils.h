@@ -8,12 +8,16 @@
 #include "env.h"
 #include "paths.h"
 #include "log.h"
+#include "alloc.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <limits.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <glob.h>
+#include <sys/time.h>
 
 #define ASSERT(label__, expr__)                                       \
         if (!(expr__)) {                                              \
@@ -23,6 +27,11 @@
 
 int test_script_parse(const char *script_path, struct sctx **out);
 
+// Performs single --watch cycle: build in forked process reporting watched paths,
+// `on_built` callback and wait for the batch of changes.
+// Returns 1 if rebuild is required, 2 if scripts must be re-evaluated.
+int test_watch_cycle(struct sctx*, void (*on_built)(void), int *build_rc);
+
 static inline int cmp_file_with_buf(const char *path, const char *buf, size_t sz) {
   struct value val = utils_file_as_buf(path, sz + 1);
   if (val.error) {
@@ -44,6 +53,46 @@ static inline int cmp_file_with_xstr(const char *path, struct xstr *xstr) {
   return cmp_file_with_buf(path, xstr_ptr(xstr), xstr_size(xstr));
 }
 
+static int _test_log_line_cmp(const void *a, const void *b) {
+  return strcmp(*(const char**) a, *(const char**) b);
+}
+
+static inline bool _test_log_line_is_sorted(const char *line) {
+  return strstr(line, " cc: build src=") || strstr(line, " cc: outdated ");
+}
+
+// Sorts runs of adjacent `cc` compile and outdated lines of check log, since compilation order
+// depends on recorded compile times and completion of parallel jobs.
+static inline const char* test_log_normalize(struct xstr *xlog) {
+  char *buf = xstrdup(xstr_ptr(xlog));
+  char *lines[1024];
+  int num = 0;
+  for (char *p = buf, *e; *p && num < sizeof(lines) / sizeof(lines[0]); p = e + 1) {
+    e = strchr(p, '\n');
+    if (!e) {
+      break;
+    }
+    *e = '\0';
+    lines[num++] = p;
+  }
+  for (int i = 0, j; i < num; i = j) {
+    for (j = i; j < num && _test_log_line_is_sorted(lines[j]); ++j);
+    if (j > i + 1) {
+      qsort(lines + i, j - i, sizeof(lines[0]), _test_log_line_cmp);
+    }
+    if (j == i) {
+      ++j;
+    }
+  }
+  xstr_clear(xlog);
+  for (int i = 0; i < num; ++i) {
+    xstr_cat(xlog, lines[i]);
+    xstr_cat2(xlog, "\n", 1);
+  }
+  free(buf);
+  return xstr_ptr(xlog);
+}
+
 static inline void test_init(bool cleanup) {
   g_env.verbose = true;
   g_env.project.cleanup = cleanup;
@@ -60,3 +109,29 @@ static inline void test_reinit(bool cleanup) {
   autark_dispose();
   test_init(cleanup);
 }
+
+// Opens the project script and builds all its rules.
+static inline void test_build(const char *path) {
+  struct sctx *sctx;
+  int rc = script_open(path, &sctx);
+  akassert(rc == 0);
+  script_build(sctx);
+  script_close(&sctx);
+}
+
+// Sets access and modification time of the file `secs` seconds ahead of the current time.
+static inline void test_touch(const char *path, int secs) {
+  struct timeval tv[2];
+  gettimeofday(&tv[0], 0);
+  tv[0].tv_sec += secs;
+  tv[1] = tv[0];
+  akassert(utimes(path, tv) == 0);
+}
+
+// Returns number of files matched by glob pattern.
+static inline int test_glob_count(const char *pattern) {
+  glob_t g;
+  int ret = glob(pattern, 0, 0, &g) == 0 ? (int) g.gl_pathc : 0;
+  globfree(&g);
+  return ret;
+}
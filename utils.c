@@ -541,6 +541,21 @@ int64_t utils_current_time_ms(void) {
   return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+uint64_t utils_hash64(const void *buf, size_t len) {
+  const uint8_t *p = buf;
+  uint64_t hash = 14695981039346656037ULL ^ len;
+  for ( ; len >= 8; len -= 8, p += 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    hash = (hash ^ w) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 29;
+  }
+  for ( ; len; --len, ++p) {
+    hash = (hash ^ *p) * 1099511628211ULL;
+  }
+  return hash;
+}
+
 const char* utils_json_escape_str(const char *val, ssize_t len, struct xstr *xstr) {
   if (!val || !xstr) {
     return 0;
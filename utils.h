@@ -127,6 +127,9 @@ int utils_fd_make_non_blocking(int fd);
 
 int64_t utils_current_time_ms(void);
 
+/// Fast non cryptographic 64 bit hash of the given buffer.
+uint64_t utils_hash64(const void *buf, size_t len);
+
 const char* utils_json_escape_str(const char *val, ssize_t len, struct xstr *xstr);
 
 //----------------------- Vlist
@@ -0,0 +1,236 @@
+#ifndef _AMALGAMATE_
+#include "vlist.h"
+#include "alloc.h"
+#include "log.h"
+#include "utils.h"
+#include "xstr.h"
+
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+static struct vlist_store* _store_create(void) {
+  struct vlist_store *s = xcalloc(1, sizeof(*s));
+  s->deps.usize = sizeof(struct vlist_store*);
+  s->refs = 1;
+  return s;
+}
+
+static void _store_release(struct vlist_store *s) {
+  if (!s || --s->refs > 0) {
+    return;
+  }
+  for (unsigned i = 0; i < s->deps.num; ++i) {
+    _store_release(*(struct vlist_store**) ulist_get(&s->deps, i));
+  }
+  ulist_destroy_keep(&s->deps);
+  pool_destroy(s->pool);
+  free(s->items);
+  free(s);
+}
+
+static void _store_dep_add(struct vlist_store *s, struct vlist_store *dep) {
+  if (s == dep) {
+    return;
+  }
+  for (unsigned i = 0; i < s->deps.num; ++i) {
+    if (*(struct vlist_store**) ulist_get(&s->deps, i) == dep) {
+      return;
+    }
+  }
+  ++dep->refs;
+  ulist_push(&s->deps, &dep);
+}
+
+static void _store_push(struct vlist_store *s, const char *ptr, size_t len) {
+  if (s->num == s->anum) {
+    s->anum = s->anum ? s->anum * 2 : 8;
+    s->items = xrealloc(s->items, s->anum * sizeof(s->items[0]));
+  }
+  s->items[s->num++] = (struct vlist_item) {
+    .ptr = ptr,
+    .len = len
+  };
+}
+
+static struct vlist* _vlist_create(struct vlist_store *s, size_t num) {
+  struct vlist *l = xcalloc(1, sizeof(*l));
+  l->store = s;
+  l->num = num;
+  l->refs = 1;
+  return l;
+}
+
+// Makes the list the only one extending its store: copy on write of item slices.
+// String form of the list is dropped since the list is going to be changed.
+static void _vlist_own_tail(struct vlist *l) {
+  if (l->str) {
+    free(l->str);
+    l->str = 0;
+  }
+  struct vlist_store *s = l->store;
+  if (l->num == s->num) {
+    return;
+  }
+  struct vlist_store *ns = _store_create();
+  ns->anum = l->num > 8 ? l->num : 8;
+  ns->items = xmalloc(ns->anum * sizeof(ns->items[0]));
+  memcpy(ns->items, s->items, l->num * sizeof(s->items[0]));
+  ns->num = l->num;
+  _store_dep_add(ns, s);
+  _store_release(s);
+  l->store = ns;
+}
+
+struct vlist* vlist_create(void) {
+  return _vlist_create(_store_create(), 0);
+}
+
+struct vlist* vlist_create_scalar(const char *val) {
+  struct vlist *l = vlist_create();
+  struct vlist_store *s = l->store;
+  size_t len = val ? strlen(val) : 0;
+  s->pool = pool_create_empty();
+  _store_push(s, pool_strndup(s->pool, val ? val : "", len), len);
+  l->num = 1;
+  l->scalar = true;
+  return l;
+}
+
+struct vlist* vlist_create_from_str(const char *val) {
+  if (!val) {
+    return vlist_create();
+  }
+  if (!is_vlist(val)) {
+    return vlist_create_scalar(val);
+  }
+  struct vlist *l = vlist_create();
+  struct vlist_iter iter;
+  vlist_iter_init(val, &iter);
+  while (vlist_iter_next(&iter)) {
+    vlist_add(l, iter.item, iter.len);
+  }
+  return l;
+}
+
+struct vlist* vlist_create_from(const struct vlist *base) {
+  struct vlist_store *s = base->store;
+  ++s->refs;
+  struct vlist *l = _vlist_create(s, base->num);
+  l->scalar = base->scalar;
+  return l;
+}
+
+struct vlist* vlist_retain(const struct vlist *l_) {
+  struct vlist *l = (struct vlist*) l_;
+  if (l) {
+    ++l->refs;
+  }
+  return l;
+}
+
+void vlist_release(struct vlist *l) {
+  if (!l || --l->refs > 0) {
+    return;
+  }
+  _store_release(l->store);
+  free(l->str);
+  free(l);
+}
+
+void vlist_add(struct vlist *l, const char *val, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  _vlist_own_tail(l);
+  struct vlist_store *s = l->store;
+  if (!s->pool) {
+    s->pool = pool_create_empty();
+  }
+  _store_push(s, pool_strndup(s->pool, val, len), len);
+  l->num = s->num;
+  l->scalar = false;
+}
+
+void vlist_add_list(struct vlist *l, const struct vlist *src) {
+  if (src->num == 0) {
+    return;
+  }
+  _vlist_own_tail(l);
+  struct vlist_store *s = l->store;
+  for (size_t i = 0; i < src->num; ++i) {
+    const struct vlist_item *item = vlist_item(src, i);
+    if (item->len) {
+      _store_push(s, item->ptr, item->len);
+    }
+  }
+  _store_dep_add(s, src->store);
+  l->num = s->num;
+  l->scalar = false;
+}
+
+void vlist_add_split(struct vlist *l, const char *val) {
+  if (is_vlist(val)) {
+    struct vlist_iter iter;
+    vlist_iter_init(val, &iter);
+    while (vlist_iter_next(&iter)) {
+      vlist_add(l, iter.item, iter.len);
+    }
+    return;
+  }
+  char buf[strlen(val) + 1];
+  const char *p = val;
+
+  while (*p) {
+    while (utils_char_is_space(*p)) ++p;
+    if (*p == '\0') {
+      break;
+    }
+    char *w = buf;
+    char q = 0;
+
+    while (*p && (q || !utils_char_is_space(*p))) {
+      if (*p == '\\') {
+        ++p;
+        if (*p) {
+          *w++ = *p++;
+        }
+      } else if (q) {
+        if (*p == q) {
+          q = 0;
+          ++p;
+        } else {
+          *w++ = *p++;
+        }
+      } else if (*p == '\'' || *p == '"') {
+        q = *p++;
+      } else {
+        *w++ = *p++;
+      }
+    }
+    vlist_add(l, buf, w - buf);
+  }
+}
+
+const char* vlist_str(const struct vlist *l_) {
+  struct vlist *l = (struct vlist*) l_;
+  if (l->str) {
+    return l->str;
+  }
+  if (l->scalar) {
+    return vlist_item(l, 0)->ptr;
+  }
+  size_t len = 0;
+  for (size_t i = 0; i < l->num; ++i) {
+    len += vlist_item(l, i)->len + 1;
+  }
+  char *wp = l->str = xmalloc(len + 1);
+  for (size_t i = 0; i < l->num; ++i) {
+    const struct vlist_item *item = vlist_item(l, i);
+    *wp++ = '\1';
+    memcpy(wp, item->ptr, item->len);
+    wp += item->len;
+  }
+  *wp = '\0';
+  return l->str;
+}
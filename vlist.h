@@ -0,0 +1,76 @@
+#ifndef VLIST_H
+#define VLIST_H
+
+#ifndef _AMALGAMATE_
+#include "basedefs.h"
+#include "pool.h"
+#include "ulist.h"
+#endif
+
+/// Immutable list values.
+/// List is a length prefixed array of string slices. Lists may share the same backing store:
+/// a list created from another list is extended in place while it is the only one appending
+/// to the store, so `..${X} item` spread is O(1). String form of list is a `\1` separated
+/// vlist string (see utils.h), it is built lazily only when list value is used as string.
+
+struct vlist_item {
+  const char *ptr; // Zero terminated item value
+  size_t      len;
+};
+
+struct vlist_store {
+  struct pool       *pool;  // Items text storage
+  struct vlist_item *items;
+  size_t num;
+  size_t anum;
+  struct ulist deps;        // Other stores items refer to (struct vlist_store*)
+  int    refs;
+};
+
+struct vlist {
+  struct vlist_store *store;
+  size_t num;               // Number of items visible to this list
+  char  *str;               // Lazily materialized string form
+  bool   scalar;            // Single value list, string form is the value itself
+  int    refs;
+};
+
+/// Creates empty list.
+struct vlist* vlist_create(void);
+
+/// Creates list from either vlist string or scalar value. Zero value is an empty list.
+struct vlist* vlist_create_from_str(const char *val);
+
+/// Creates scalar single item list.
+struct vlist* vlist_create_scalar(const char *val);
+
+/// Creates new list started with all items of the given base list.
+/// The store of base list is shared if it is not extended by anyone else.
+struct vlist* vlist_create_from(const struct vlist *base);
+
+struct vlist* vlist_retain(const struct vlist*);
+
+void vlist_release(struct vlist*);
+
+/// Appends item to the list. Empty items are skipped as in vlist strings.
+void vlist_add(struct vlist*, const char *val, size_t len);
+
+/// Appends all items of `src` list to the list without copying of item values.
+void vlist_add_list(struct vlist*, const struct vlist *src);
+
+/// Appends whitespace separated, optionally quoted values of `val`.
+void vlist_add_split(struct vlist*, const char *val);
+
+/// Returns true if list is a multi value list, false if it is scalar or empty.
+static inline bool vlist_is_list(const struct vlist *l) {
+  return !l->scalar && l->num > 0;
+}
+
+static inline const struct vlist_item* vlist_item(const struct vlist *l, size_t idx) {
+  return &l->store->items[idx];
+}
+
+/// Returns string form of the list. Scalar value for scalar list and vlist string otherwise.
+const char* vlist_str(const struct vlist*);
+
+#endif
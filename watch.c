@@ -0,0 +1,349 @@
+#ifndef _AMALGAMATE_
+#include "watch.h"
+#include "env.h"
+#include "log.h"
+#include "map.h"
+#include "paths.h"
+#include "pathid.h"
+#include "utils.h"
+#include "alloc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#endif
+
+#ifdef __linux__
+
+#define WATCH_BATCH_MS 50
+
+#define WATCH_NONE    0
+#define WATCH_REBUILD 1
+#define WATCH_REEVAL  2
+
+struct _watch {
+  int fd;
+  struct map *wds;   // Inotify watch descriptor -> dir path id
+  struct map *dirs;  // Watched dir path id -> 1
+  struct map *init;  // Path ids checked in init/setup phases -> 1
+  struct ulist created; // Unknown files created in the current batch (char*)
+  struct sctx *sctx;
+  const struct ulist *targets;
+  const char  *cwd;
+  char *const *argv;
+};
+
+static bool _watch_in_cache(const char *path) {
+  return path_is_prefix_for(g_env.project.cache_dir, path, 0) != 0;
+}
+
+static void _watch_dir(struct _watch *w, const char *dir) {
+  if (_watch_in_cache(dir)) {
+    return;
+  }
+  uint32_t id = pathid_intern(dir);
+  if (map_get_u32(w->dirs, id)) {
+    return;
+  }
+  map_put_u32(w->dirs, id, (void*) 1);
+  int wd = inotify_add_watch(w->fd, pathid_path(id), IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE
+                             | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR);
+  if (wd == -1) {
+    if (g_env.verbose) {
+      akwarn("Failed to watch: %s %s", pathid_path(id), strerror(errno));
+    }
+    return;
+  }
+  if (g_env.verbose) {
+    akinfo("Watching: %s", pathid_path(id));
+  }
+  map_put_u32(w->wds, wd, (void*) (uintptr_t) id);
+}
+
+// Reports dirs to watch and known source paths to the watching process.
+static void _watch_report(FILE *out) {
+  for (int i = 0; i < g_env.units.num; ++i) {
+    struct unit *unit = *(struct unit**) ulist_get(&g_env.units, i);
+    fprintf(out, "D %s\n", unit->dir);
+  }
+  for (uint32_t id = 1; id <= g_env.pathids.entries.num; ++id) {
+    const struct pathid_entry *e = pathid_entry(id);
+    if (_watch_in_cache(e->path)) {
+      continue;
+    }
+    fprintf(out, "F %s\n", e->path);
+    if ((e->flags & PATHID_FLG_STAT) && e->stat.ftype != AKPATH_NOT_EXISTS) {
+      if (e->stat.ftype == AKPATH_TYPE_DIR) {
+        fprintf(out, "D %s\n", e->path);
+      } else if (e->parent) {
+        fprintf(out, "D %s\n", pathid_path(e->parent));
+      }
+    }
+  }
+}
+
+static int _watch_build(struct _watch *w) {
+  int pfd[2];
+  if (pipe(pfd)) {
+    akfatal(errno, "pipe", 0);
+  }
+  // Keep report pipe closed in processes spawned by build
+  fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+  fcntl(pfd[1], F_SETFD, FD_CLOEXEC);
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    akfatal(errno, "fork", 0);
+  }
+  if (pid == 0) {
+    close(pfd[0]);
+    if (w->targets->num) {
+      script_build_targets(w->sctx, w->targets);
+    } else {
+      script_build(w->sctx);
+    }
+    FILE *out = fdopen(pfd[1], "w");
+    if (out) {
+      _watch_report(out);
+      fclose(out);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+  }
+
+  close(pfd[1]);
+  FILE *in = fdopen(pfd[0], "r");
+  if (!in) {
+    akfatal(errno, "fdopen", 0);
+  }
+  char *line = 0;
+  size_t len = 0;
+  ssize_t nr;
+  while ((nr = getline(&line, &len, in)) > 2) {
+    line[nr - 1] = '\0';
+    if (line[0] == 'D') {
+      _watch_dir(w, line + 2);
+    } else {
+      pathid_intern_normalized(line + 2);
+    }
+  }
+  free(line);
+  fclose(in);
+
+  int wstatus = 0;
+  while (waitpid(pid, &wstatus, 0) == -1) {
+    if (errno != EINTR) {
+      akfatal(errno, "waitpid", 0);
+    }
+  }
+  return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+}
+
+static int _watch_event(struct _watch *w, const struct inotify_event *ev) {
+  if (ev->mask & IN_Q_OVERFLOW) {
+    return WATCH_REEVAL;
+  }
+  uint32_t dir = (uint32_t) (uintptr_t) map_get_u32(w->wds, ev->wd);
+  if (!dir) {
+    return WATCH_NONE;
+  }
+  if (ev->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+    return WATCH_REEVAL;
+  }
+  if (ev->len == 0 || ev->name[0] == '\0') {
+    return WATCH_NONE;
+  }
+  const char *name = ev->name;
+  size_t nlen = strlen(name);
+  if (name[0] == '.' || name[nlen - 1] == '~') {
+    // Hidden and editor backup files
+    return WATCH_NONE;
+  }
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", pathid_path(dir), name);
+  if (_watch_in_cache(path)) {
+    return WATCH_NONE;
+  }
+  uint32_t id = pathid_find_normalized(path);
+  if (strcmp(name, AUTARK_SCRIPT) == 0 || unit_for_path(path) || (id && map_get_u32(w->init, id))) {
+    if (g_env.verbose) {
+      akinfo("Script changed: %s", path);
+    }
+    return WATCH_REEVAL;
+  }
+  if (ev->mask & IN_ISDIR) {
+    return (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) ? WATCH_REEVAL : WATCH_NONE;
+  }
+  if (!id) {
+    if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+      // New file may change the results of glob evaluated in init phase,
+      // checked at the end of batch since editors create short living temp files.
+      char *p = xstrdup(path);
+      ulist_push(&w->created, &p);
+    }
+    return WATCH_NONE;
+  }
+  if (g_env.verbose) {
+    akinfo("Changed: %s", path);
+  }
+  return WATCH_REBUILD;
+}
+
+// Waits for the batch of changes.
+static int _watch_wait(struct _watch *w) {
+  char buf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+  int ret = WATCH_NONE;
+  int timeout = -1;
+
+  for (;;) {
+    struct pollfd pfd = { .fd = w->fd, .events = POLLIN };
+    int rc = poll(&pfd, 1, timeout);
+    if (rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      akfatal(errno, "poll", 0);
+    }
+    if (rc == 0) {
+      for (int i = 0; i < w->created.num; ++i) {
+        char *p = *(char**) ulist_get(&w->created, i);
+        if (ret != WATCH_REEVAL && path_is_exist(p)) {
+          if (g_env.verbose) {
+            akinfo("File added: %s", p);
+          }
+          ret = WATCH_REEVAL;
+        }
+        free(p);
+      }
+      ulist_clear(&w->created);
+      return ret;
+    }
+    ssize_t len = read(w->fd, buf, sizeof(buf));
+    if (len == -1) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      akfatal(errno, "read inotify", 0);
+    }
+    for (char *p = buf; p < buf + len; ) {
+      const struct inotify_event *ev = (const struct inotify_event*) p;
+      int r = _watch_event(w, ev);
+      if (r > ret) {
+        ret = r;
+      }
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+    if (ret != WATCH_NONE || w->created.num) {
+      // Collect the rest of batch
+      timeout = WATCH_BATCH_MS;
+    }
+  }
+}
+
+__attribute__((noreturn))
+static void _watch_reexec(struct _watch *w) {
+  akinfo("[%s] Restarting for full re-evaluation", g_env.project.root_dir);
+  close(w->fd);
+  setenv(AUTARK_WATCH_ENV, "1", 1);
+  if (chdir(w->cwd)) {
+    akfatal(errno, "Failed to change dir to: %s", w->cwd);
+  }
+  fflush(stdout);
+  fflush(stderr);
+  execv("/proc/self/exe", w->argv);
+  akfatal(errno, "Failed to restart autark", 0);
+}
+
+static void _watch_init(struct _watch *w) {
+  w->wds = map_create_u32(0);
+  w->dirs = map_create_u32(0);
+  w->init = map_create_u32(0);
+  w->created = (struct ulist) { .usize = sizeof(char*) };
+  w->fd = inotify_init1(IN_CLOEXEC);
+  if (w->fd == -1) {
+    akfatal(errno, "inotify_init1", 0);
+  }
+  for (int i = 0; i < g_env.units.num; ++i) {
+    struct unit *unit = *(struct unit**) ulist_get(&g_env.units, i);
+    _watch_dir(w, unit->dir);
+  }
+  // Dependencies of init/setup phases (check scripts, etc.) require full re-evaluation
+  for (uint32_t id = 1; id <= g_env.pathids.entries.num; ++id) {
+    const struct pathid_entry *e = pathid_entry(id);
+    if ((e->flags & PATHID_FLG_STAT) && !_watch_in_cache(e->path)) {
+      map_put_u32(w->init, id, (void*) 1);
+    }
+  }
+}
+
+void watch_run(struct sctx *sctx, const struct ulist *targets, const char *cwd, char *const *argv) {
+  struct _watch w = {
+    .sctx = sctx,
+    .targets = targets,
+    .cwd = cwd,
+    .argv = argv,
+  };
+  _watch_init(&w);
+
+  for (;;) {
+    int64_t ts = utils_current_time_ms();
+    int rc = _watch_build(&w);
+    if (rc == 0) {
+      akinfo("[%s] Build successful in %" PRId64 "ms", g_env.project.root_dir, utils_current_time_ms() - ts);
+    } else {
+      akwarn("[%s] Build failed", g_env.project.root_dir);
+    }
+    akinfo("[%s] Watching for changes...", g_env.project.root_dir);
+
+    int ev;
+    while ((ev = _watch_wait(&w)) == WATCH_NONE);
+    if (ev == WATCH_REEVAL) {
+      _watch_reexec(&w);
+    }
+  }
+}
+
+#ifdef TESTS
+
+int test_watch_cycle(struct sctx *sctx, void (*on_built)(void), int *build_rc) {
+  struct ulist targets = { .usize = sizeof(char*) };
+  struct _watch w = {
+    .sctx = sctx,
+    .targets = &targets,
+  };
+  _watch_init(&w);
+  *build_rc = _watch_build(&w);
+  on_built();
+  int ev;
+  while ((ev = _watch_wait(&w)) == WATCH_NONE);
+  close(w.fd);
+  map_destroy(w.wds);
+  map_destroy(w.dirs);
+  map_destroy(w.init);
+  ulist_destroy_keep(&w.created);
+  return ev;
+}
+
+#endif
+
+#else
+
+void watch_run(struct sctx *sctx, const struct ulist *targets, const char *cwd, char *const *argv) {
+  akfatal(AK_ERROR_NOT_IMPLEMENTED, "--watch mode is supported only on Linux", 0);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#ifndef _AMALGAMATE_
+#include "script.h"
+#include "ulist.h"
+#endif
+
+/// Continuous incremental rebuilds (`--watch`), Linux only.
+///
+/// Script graph evaluated by init/setup phases is kept in memory. Every build
+/// is performed in a forked process, so a failed build does not stop watching.
+/// Source dirs of units and dirs of checked dependencies are watched by inotify,
+/// each batch of changes triggers rebuild of outdated rules. Changes of Autark
+/// scripts and added or removed source files re-execute autark for full re-evaluation.
+///
+/// `targets` is a list of build targets (struct ulist<char*>), may be empty.
+/// `cwd` and `argv` are initial working directory and arguments used to re-execute autark.
+/// This function never returns.
+__attribute__((noreturn))
+void watch_run(struct sctx*, const struct ulist *targets, const char *cwd, char *const *argv);
+
+#endif